@@ -0,0 +1,411 @@
+#include <iostream>
+#include <random>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "cptlib.h"
+using namespace std::chrono_literals;
+
+#define report(name, value, unit) std::cout << "  " << (name) << ": " << (value) << " " << (unit) << std::endl
+
+void EventLoopBench() {
+    std::cout << "event_loop" << std::endl;
+    // context switch: two coroutines yielding to each other
+    {
+        constexpr int switches = 1'000'000;
+        cpt::event_loop loop;
+        auto yielder = []() -> cpt::task<void> {
+            for (int i = 0; i < switches / 2; i++)
+                co_await cpt::yield();
+        };
+        loop.spawn(yielder());
+        loop.spawn(yielder());
+        cpt::time_point start;
+        loop.run();
+        report("yield switch", start.elapsed().fNano() / switches, "ns");
+    }
+    // timer dispatch: 100K coroutines sleeping for random durations
+    {
+        constexpr int sleepers = 100'000;
+        cpt::event_loop loop;
+        std::mt19937 random(42);
+        std::uniform_int_distribution<int> delay(0, 200);
+        cpt::time_duration totalLateness;
+        auto sleeper = [](cpt::time_duration delay, cpt::time_duration& totalLateness) -> cpt::task<void> {
+            cpt::time_point deadline = cpt::time_point() + delay;
+            co_await cpt::sleep_until(deadline);
+            totalLateness += cpt::time_point() - deadline;
+        };
+        cpt::time_point spawnStart;
+        for (int i = 0; i < sleepers; i++)
+            loop.spawn(sleeper(std::chrono::milliseconds(delay(random)), totalLateness));
+        cpt::time_duration spawnTime = spawnStart.elapsed();
+        cpt::time_point start;
+        loop.run();
+        cpt::time_duration runTime = start.elapsed();
+        report("spawn", spawnTime.fNano() / sleepers, "ns/coroutine");
+        report("run (200ms of sleeping)", runTime.fMilli(), "ms");
+        report("mean lateness", totalLateness.fMicro() / sleepers, "us");
+    }
+}
+
+void PeriodicExecutorBench() {
+    std::cout << "periodic_executor" << std::endl;
+    constexpr int tasks = 10'000;
+    for (cpt::time_duration period : {cpt::time_duration(100ms), cpt::time_duration(1ms)}) {
+        std::atomic<uint64_t> runs = 0;
+        cpt::thread_pool pool;
+        cpt::periodic_executor executor(pool);
+        std::vector<cpt::periodic_executor<>::task_id> ids;
+        cpt::time_point first = cpt::time_point() + 10ms;
+        for (int i = 0; i < tasks; i++)
+            ids.push_back(executor.schedule(period, [&runs] { runs.fetch_add(1, std::memory_order_relaxed); },
+                                            cpt::missed_tick_policy::skip, first + period * i / tasks));
+        std::this_thread::sleep_until((first + 2s).chrono());
+        uint64_t totalRuns = runs.load();
+        cpt::time_duration meanLateness, maxLateness;
+        for (auto id : ids) {
+            cpt::lateness_stats stats = *executor.stats(id);
+            meanLateness += stats.mean / tasks;
+            maxLateness = std::max(maxLateness, stats.max);
+        }
+        std::cout << " period " << period.fMilli() << "ms, " << pool.size() << " threads" << std::endl;
+        report("throughput", totalRuns / 2.0, "runs/s");
+        report("expected", tasks / period.fSec(), "runs/s");
+        report("mean lateness", meanLateness.fMicro(), "us");
+        report("max lateness", maxLateness.fMicro(), "us");
+    }
+}
+
+template <class Clock>
+void WatchdogBench_Beat(const char* name) {
+    constexpr int beats = 10'000'000;
+    cpt::watchdog<Clock> watchdog(1s, 100ms, [](const auto&, cpt::time_duration) {});
+    auto& heartbeat = watchdog.add();
+    cpt::time_point start;
+    for (int i = 0; i < beats; i++)
+        heartbeat.beat();
+    report(name, start.elapsed().fNano() / beats, "ns/beat");
+}
+void WatchdogBench() {
+    std::cout << "watchdog" << std::endl;
+    WatchdogBench_Beat<std::chrono::steady_clock>("beat steady_clock");
+    WatchdogBench_Beat<cpt::clocks::coarse_clock>("beat coarse_clock");
+    WatchdogBench_Beat<cpt::clocks::pauseable_clock_st<>>("beat pauseable_clock_st");
+    // detection latency: real time from crossing the threshold to the handler call. coarse_clock readings lag by up to
+    // a kernel tick, so this includes that error and can be negative.
+    for (cpt::time_duration interval : {cpt::time_duration(1ms), cpt::time_duration(10ms)}) {
+        constexpr int stalls = 20;
+        constexpr auto threshold = 20ms;
+        std::atomic<bool> detected = false;
+        cpt::time_point detectedAt;
+        cpt::watchdog<cpt::clocks::coarse_clock> watchdog(threshold, interval, [&](const auto&, cpt::time_duration) {
+            detectedAt = cpt::time_point();
+            detected = true;
+        });
+        auto& heartbeat = watchdog.add();
+        cpt::time_duration total, best, worst;
+        for (int i = 0; i < stalls; i++) {
+            // spread the beats over the scan phase
+            std::this_thread::sleep_for((interval * i / stalls).chrono());
+            detected = false;
+            heartbeat.beat();
+            cpt::time_point lastBeat;
+            while (!detected)
+                std::this_thread::sleep_for(100us);
+            cpt::time_duration latency = detectedAt - lastBeat - threshold;
+            total += latency;
+            best = i == 0 ? latency : std::min(best, latency);
+            worst = i == 0 ? latency : std::max(worst, latency);
+        }
+        std::cout << " scan interval " << interval.fMilli() << "ms" << std::endl;
+        report("min detection latency", best.fMilli(), "ms");
+        report("mean detection latency", (total / stalls).fMilli(), "ms");
+        report("max detection latency", worst.fMilli(), "ms");
+    }
+}
+
+template <class Clock>
+void SharedPauseableClockBench_Now(const char* name) {
+    constexpr int reads = 10'000'000;
+    int64_t sink = 0;
+    cpt::time_point start;
+    for (int i = 0; i < reads; i++)
+        sink += Clock::now().time_since_epoch().count();
+    report(name, start.elapsed().fNano() / reads, "ns/now");
+    if (sink == 42)
+        std::cout << std::endl;
+}
+void SharedPauseableClockBench() {
+    using clock = cpt::clocks::shared_pauseable_clock<"/cptlib_bench_clock">;
+    std::cout << "shared_pauseable_clock" << std::endl;
+    clock::unlink();
+    clock::attach();
+    SharedPauseableClockBench_Now<std::chrono::steady_clock>("steady_clock");
+    SharedPauseableClockBench_Now<cpt::clocks::pauseable_clock_st<>>("pauseable_clock_st");
+    SharedPauseableClockBench_Now<clock>("shared_pauseable_clock");
+    // another process keeps pausing and resuming
+    pid_t child = fork();
+    if (child == 0) {
+        while (true) {
+            clock::pause();
+            clock::resume();
+        }
+    }
+    SharedPauseableClockBench_Now<clock>("shared_pauseable_clock, other process writing");
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    // the killed writer may have died mid-update
+    SharedPauseableClockBench_Now<clock>("shared_pauseable_clock, after writer was killed");
+    clock::unlink();
+}
+
+void ThroughputMeterBench() {
+    std::cout << "throughput_meter" << std::endl;
+    constexpr auto runFor = 300ms;
+    for (size_t threads : {1, 2, 4, 8}) {
+        cpt::throughput_meter meter(100ms, 10);
+        std::atomic<uint64_t> sharedCounter = 0;
+        std::atomic<int64_t> sharedLast = 0;
+        std::atomic<uint64_t> meterEvents = 0, sharedEvents = 0;
+        auto measure = [&](auto&& recordOne, std::atomic<uint64_t>& events) {
+            std::vector<std::thread> workers;
+            for (size_t i = 0; i < threads; i++) {
+                workers.emplace_back([&] {
+                    uint64_t count = 0;
+                    for (cpt::time_point start; start.elapsed() < runFor;) {
+                        for (int j = 0; j < 1000; j++)
+                            recordOne();
+                        count += 1000;
+                    }
+                    events += count;
+                });
+            }
+            for (std::thread& worker : workers)
+                worker.join();
+        };
+        measure([&] { meter.record(); }, meterEvents);
+        // baseline: one shared counter and a steady_clock read per event
+        measure(
+            [&] {
+                sharedCounter.fetch_add(1, std::memory_order_relaxed);
+                sharedLast.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+            },
+            sharedEvents);
+        std::cout << " " << threads << " threads" << std::endl;
+        report("throughput_meter", meterEvents / cpt::time_duration(runFor).fSec() / 1e6, "M events/s");
+        report("shared atomic + steady_clock", sharedEvents / cpt::time_duration(runFor).fSec() / 1e6, "M events/s");
+    }
+}
+
+void WaitBench() {
+    std::cout << "waiting" << std::endl;
+    constexpr int roundTrips = 50'000;
+    // ping-pong between two threads
+    {
+        cpt::semaphore ping, pong;
+        std::thread other([&] {
+            for (int i = 0; i < roundTrips; i++) {
+                ping.acquire();
+                pong.release();
+            }
+        });
+        cpt::time_point start;
+        for (int i = 0; i < roundTrips; i++) {
+            ping.release();
+            pong.acquire();
+        }
+        report("semaphore round trip", start.elapsed().fNano() / roundTrips, "ns");
+        other.join();
+    }
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+        int turn = 0;
+        std::thread other([&] {
+            for (int i = 0; i < roundTrips; i++) {
+                std::unique_lock lock(mutex);
+                condition.wait(lock, [&] { return turn == 1; });
+                turn = 0;
+                condition.notify_one();
+            }
+        });
+        cpt::time_point start;
+        for (int i = 0; i < roundTrips; i++) {
+            std::unique_lock lock(mutex);
+            turn = 1;
+            condition.notify_one();
+            condition.wait(lock, [&] { return turn == 0; });
+        }
+        report("condition_variable round trip", start.elapsed().fNano() / roundTrips, "ns");
+        other.join();
+    }
+    // timeout overshoot
+    {
+        constexpr int waits = 200;
+        cpt::event event;
+        cpt::time_duration overshoot;
+        for (int i = 0; i < waits; i++) {
+            cpt::time_point deadline = cpt::time_point() + 1ms;
+            event.wait_until(deadline);
+            overshoot += cpt::time_point() - deadline;
+        }
+        report("event 1ms timeout overshoot", (overshoot / waits).fMicro(), "us");
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        overshoot = {};
+        for (int i = 0; i < waits; i++) {
+            cpt::time_point deadline = cpt::time_point() + 1ms;
+            std::unique_lock lock(mutex);
+            condition.wait_until(lock, deadline.chrono());
+            overshoot += cpt::time_point() - deadline;
+        }
+        report("condition_variable 1ms timeout overshoot", (overshoot / waits).fMicro(), "us");
+    }
+    // the clock is paused for 20ms during a 10ms wait, the wait has to end 30ms after it started
+    {
+        struct WaitBenchClockId {};
+        using clock = cpt::clocks::pauseable_clock_st<WaitBenchClockId>;
+        auto pauseDuringWait = [] {
+            std::this_thread::sleep_for(2ms);
+            clock::pause();
+            std::this_thread::sleep_for(20ms);
+            clock::resume();
+        };
+        std::atomic<uint32_t> word = 0;
+        std::thread pauser(pauseDuringWait);
+        cpt::time_point start;
+        cpt::atomic_wait_until(word, 0, cpt::time_point<clock>() + 10ms);
+        report("atomic_wait_until, paused clock (expect 30)", start.elapsed().fMilli(), "ms");
+        pauser.join();
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        pauser = std::thread(pauseDuringWait);
+        start = cpt::time_point();
+        {
+            std::unique_lock lock(mutex);
+            condition.wait_until(lock, (cpt::time_point<clock>() + 10ms).chrono());
+        }
+        report("condition_variable::wait_until, paused clock (expect 30)", start.elapsed().fMilli(), "ms");
+        pauser.join();
+    }
+}
+
+void IntervalIndexBench() {
+    std::cout << "interval_index" << std::endl;
+    using index_type = cpt::interval_index<>;
+    using point = cpt::time_point<>;
+    constexpr size_t spans = 10'000'000;
+    constexpr auto timeline = std::chrono::hours(1);
+    std::mt19937_64 random(1);
+    std::uniform_int_distribution<int64_t> begins(0, std::chrono::nanoseconds(timeline).count());
+    std::exponential_distribution<double> lengths(1.0 / 1e6); // 1ms on average
+    std::vector<index_type::interval> intervals;
+    intervals.reserve(spans);
+    for (size_t i = 0; i < spans; i++) {
+        int64_t begin = begins(random);
+        intervals.push_back({point(std::chrono::nanoseconds(begin)), point(std::chrono::nanoseconds(begin + int64_t(lengths(random))))});
+    }
+
+    cpt::time_point start;
+    index_type index(intervals);
+    report("bulk build", start.elapsed().fMilli(), "ms");
+
+    std::sort(intervals.begin(), intervals.end(), [](const auto& lhs, const auto& rhs) { return lhs.begin < rhs.begin; });
+    index_type streamed;
+    start = cpt::time_point();
+    for (const index_type::interval& interval : intervals)
+        streamed.append(interval.begin, interval.end);
+    report("streaming append", start.elapsed().fNano() / spans, "ns/span");
+
+    constexpr int queries = 100'000;
+    size_t hits = 0;
+    start = cpt::time_point();
+    for (int i = 0; i < queries; i++)
+        index.for_each_overlap(point(std::chrono::nanoseconds(begins(random))), [&hits](size_t, const auto&) { hits++; });
+    report("stabbing query", start.elapsed().fNano() / queries, "ns");
+    report("stabbing hits", double(hits) / queries, "spans/query");
+
+    hits = 0;
+    start = cpt::time_point();
+    for (int i = 0; i < queries; i++) {
+        point from(std::chrono::nanoseconds(begins(random)));
+        index.for_each_overlap(from, from + 100ms, [&hits](size_t, const auto&) { hits++; });
+    }
+    report("100ms range query", start.elapsed().fNano() / queries, "ns");
+    report("100ms range hits", double(hits) / queries, "spans/query");
+
+    start = cpt::time_point();
+    size_t concurrency = 0;
+    for (int i = 0; i < queries / 100; i++) {
+        point from(std::chrono::nanoseconds(begins(random)));
+        concurrency += index.max_concurrency(from, from + 100ms);
+        concurrency += index.covered(from, from + 100ms).iNano() != 0;
+    }
+    report("100ms covered + max_concurrency", start.elapsed().fMicro() / (queries / 100), "us");
+
+    // linear scan, for comparison
+    constexpr int scans = 10;
+    hits = 0;
+    start = cpt::time_point();
+    for (int i = 0; i < scans; i++) {
+        point at(std::chrono::nanoseconds(begins(random)));
+        for (const index_type::interval& interval : intervals)
+            hits += interval.begin <= at && interval.end > at;
+    }
+    report("linear scan stabbing query", start.elapsed().fMilli() / scans, "ms");
+    if (concurrency == 42 || hits == 42)
+        std::cout << std::endl;
+}
+
+void TimeDurationAsBench_Run(const char* name, const std::vector<cpt::time_duration>& durations, auto convert) {
+    constexpr int rounds = 20;
+    int64_t sum = 0;
+    cpt::time_point start;
+    for (int round = 0; round < rounds; round++) {
+        for (const cpt::time_duration& duration : durations)
+            sum += convert(duration);
+    }
+    report(name, start.elapsed().fNano() / (rounds * durations.size()), "ns/conversion");
+    if (sum == 42)
+        std::cout << std::endl;
+}
+void TimeDurationAsBench() {
+    std::cout << "time_duration::as" << std::endl;
+    std::mt19937_64 random(1);
+    std::uniform_int_distribution<int64_t> values(std::numeric_limits<int64_t>::min() / 2, std::numeric_limits<int64_t>::max() / 2);
+    std::vector<cpt::time_duration> durations(1'000'000);
+    for (cpt::time_duration& duration : durations)
+        duration = std::chrono::nanoseconds(values(random));
+    using namespace std::chrono;
+    TimeDurationAsBench_Run("as<milli>", durations, [](cpt::time_duration d) { return d.as<std::milli>(); });
+    TimeDurationAsBench_Run("duration_cast<milliseconds>", durations,
+                            [](cpt::time_duration d) { return duration_cast<milliseconds>(nanoseconds(d)).count(); });
+    TimeDurationAsBench_Run("as<milli, floor>", durations,
+                            [](cpt::time_duration d) { return d.as<std::milli, int64_t, cpt::rounding::floor>(); });
+    TimeDurationAsBench_Run("floor<milliseconds>", durations,
+                            [](cpt::time_duration d) { return floor<milliseconds>(nanoseconds(d)).count(); });
+    TimeDurationAsBench_Run("as<milli, round>", durations,
+                            [](cpt::time_duration d) { return d.as<std::milli, int64_t, cpt::rounding::round>(); });
+    TimeDurationAsBench_Run("round<milliseconds>", durations,
+                            [](cpt::time_duration d) { return round<milliseconds>(nanoseconds(d)).count(); });
+    TimeDurationAsBench_Run("as<ratio<3600>, round>", durations,
+                            [](cpt::time_duration d) { return d.as<std::ratio<3600>, int64_t, cpt::rounding::round>(); });
+    TimeDurationAsBench_Run("round<hours>", durations, [](cpt::time_duration d) { return round<hours>(nanoseconds(d)).count(); });
+}
+
+int main() {
+    EventLoopBench();
+    PeriodicExecutorBench();
+    WatchdogBench();
+    SharedPauseableClockBench();
+    ThroughputMeterBench();
+    WaitBench();
+    IntervalIndexBench();
+    TimeDurationAsBench();
+    return 0;
+}
@@ -1,9 +1,77 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <stdint.h>
+#include <system_error>
+#include <thread>
+#include <typeindex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#endif
 
 namespace cpt {
+// How integer conversions to a coarser unit round. 'trunc' matches duration_cast, 'round' is half to even like std::chrono::round.
+enum class rounding { trunc, floor, ceil, round };
+
+namespace detail {
+template <class T>
+struct is_ratio : std::false_type {};
+template <intmax_t Num, intmax_t Den>
+struct is_ratio<std::ratio<Num, Den>> : std::true_type {};
+template <class T>
+inline constexpr bool is_ratio_v = is_ratio<T>::value;
+
+// Quotient by a constant, rounded per 'Mode'. The compiler lowers the constant division to a multiply-high, and the
+// rounding is a branch-free fix-up from the remainder, so unlike std::chrono::floor/round it cannot overflow.
+template <int64_t Divisor, rounding Mode>
+constexpr int64_t divide_by(int64_t n) noexcept {
+    static_assert(Divisor > 1);
+    const int64_t quotient = n / Divisor;
+    const int64_t remainder = n - quotient * Divisor;
+    if constexpr (Mode == rounding::floor) {
+        return quotient - (remainder < 0);
+    } else if constexpr (Mode == rounding::ceil) {
+        return quotient + (remainder > 0);
+    } else if constexpr (Mode == rounding::round) {
+        // |remainder| < Divisor, so doubling it cannot overflow; ties go to the even quotient
+        const int64_t twice = 2 * (remainder < 0 ? -remainder : remainder);
+        const int64_t away = (twice > Divisor) | ((twice == Divisor) & (quotient & 1));
+        return quotient + away * ((remainder > 0) - (remainder < 0));
+    } else {
+        return quotient;
+    }
+}
+} // namespace detail
+
 class time_duration {
 public:
     using floatRep = double;
@@ -21,43 +89,48 @@ public:
     constexpr time_duration(const std::chrono::duration<Rep, Period>& duration) noexcept(std::is_arithmetic_v<Rep>)
         : m_duration(std::chrono::duration_cast<decltype(m_duration)>(duration)) {}
 
-    constexpr double fNano() const noexcept {
-        return std::chrono::duration_cast<std::chrono::duration<floatRep, std::chrono::nanoseconds::period>>(m_duration).count();
-    }
-    constexpr double fMicro() const noexcept {
-        return std::chrono::duration_cast<std::chrono::duration<floatRep, std::chrono::microseconds::period>>(m_duration).count();
-    }
-    constexpr double fMilli() const noexcept {
-        return std::chrono::duration_cast<std::chrono::duration<floatRep, std::chrono::milliseconds::period>>(m_duration).count();
-    }
-    constexpr double fSec() const noexcept {
-        return std::chrono::duration_cast<std::chrono::duration<floatRep, std::chrono::seconds::period>>(m_duration).count();
-    }
-    constexpr double fMin() const noexcept {
-        return std::chrono::duration_cast<std::chrono::duration<floatRep, std::chrono::minutes::period>>(m_duration).count();
-    }
-    constexpr double fHour() const noexcept {
-        return std::chrono::duration_cast<std::chrono::duration<floatRep, std::chrono::hours::period>>(m_duration).count();
+    // Count in 'Unit'. Integer conversions to coarser units round per 'Mode' and are exact over the whole range.
+    // Conversions to finer units multiply, and overflow just like duration_cast when the result does not fit.
+    // Floating point counts keep the fraction, so they take no other 'Mode' than trunc.
+    template <class Unit, class Rep = intRep, rounding Mode = rounding::trunc>
+        requires(detail::is_ratio_v<Unit> && std::is_arithmetic_v<Rep> && (std::is_integral_v<Rep> || Mode == rounding::trunc))
+    constexpr Rep as() const noexcept {
+        using factor = std::ratio_divide<thisPeriod, Unit>;
+        const thisRep count = m_duration.count();
+        if constexpr (std::is_floating_point_v<Rep>) {
+            return std::chrono::duration_cast<std::chrono::duration<Rep, Unit>>(m_duration).count();
+        } else if constexpr (factor::num == 1 && factor::den == 1) {
+            return static_cast<Rep>(count);
+        } else if constexpr (factor::den == 1) {
+            return static_cast<Rep>(count * factor::num);
+        } else if constexpr (factor::num == 1 && std::is_same_v<thisRep, int64_t>) {
+            return static_cast<Rep>(detail::divide_by<int64_t(factor::den), Mode>(count));
+        } else {
+            using target = std::chrono::duration<thisRep, Unit>;
+            if constexpr (Mode == rounding::floor)
+                return static_cast<Rep>(std::chrono::floor<target>(m_duration).count());
+            else if constexpr (Mode == rounding::ceil)
+                return static_cast<Rep>(std::chrono::ceil<target>(m_duration).count());
+            else if constexpr (Mode == rounding::round)
+                return static_cast<Rep>(std::chrono::round<target>(m_duration).count());
+            else
+                return static_cast<Rep>(std::chrono::duration_cast<target>(m_duration).count());
+        }
     }
 
-    constexpr int64_t iNano() const noexcept {
-        return std::chrono::duration_cast<std::chrono::duration<intRep, std::chrono::nanoseconds::period>>(m_duration).count();
-    }
-    constexpr int64_t iMicro() const noexcept {
-        return std::chrono::duration_cast<std::chrono::duration<intRep, std::chrono::microseconds::period>>(m_duration).count();
-    }
-    constexpr int64_t iMilli() const noexcept {
-        return std::chrono::duration_cast<std::chrono::duration<intRep, std::chrono::milliseconds::period>>(m_duration).count();
-    }
-    constexpr int64_t iSec() const noexcept {
-        return std::chrono::duration_cast<std::chrono::duration<intRep, std::chrono::seconds::period>>(m_duration).count();
-    }
-    constexpr int64_t iMin() const noexcept {
-        return std::chrono::duration_cast<std::chrono::duration<intRep, std::chrono::minutes::period>>(m_duration).count();
-    }
-    constexpr int64_t iHour() const noexcept {
-        return std::chrono::duration_cast<std::chrono::duration<intRep, std::chrono::hours::period>>(m_duration).count();
-    }
+    constexpr double fNano() const noexcept { return as<std::nano, floatRep>(); }
+    constexpr double fMicro() const noexcept { return as<std::micro, floatRep>(); }
+    constexpr double fMilli() const noexcept { return as<std::milli, floatRep>(); }
+    constexpr double fSec() const noexcept { return as<std::ratio<1>, floatRep>(); }
+    constexpr double fMin() const noexcept { return as<std::ratio<60>, floatRep>(); }
+    constexpr double fHour() const noexcept { return as<std::ratio<3600>, floatRep>(); }
+
+    constexpr int64_t iNano() const noexcept { return as<std::nano, intRep>(); }
+    constexpr int64_t iMicro() const noexcept { return as<std::micro, intRep>(); }
+    constexpr int64_t iMilli() const noexcept { return as<std::milli, intRep>(); }
+    constexpr int64_t iSec() const noexcept { return as<std::ratio<1>, intRep>(); }
+    constexpr int64_t iMin() const noexcept { return as<std::ratio<60>, intRep>(); }
+    constexpr int64_t iHour() const noexcept { return as<std::ratio<3600>, intRep>(); }
 
     constexpr auto chrono() const noexcept { return m_duration; }
 
@@ -337,10 +410,68 @@ private:
 };
 } // namespace cpt
 
+namespace cpt::detail {
+#if defined(__linux__)
+// Sleeps while 'word == expected', until woken or 'monotonicDeadline' (absolute CLOCK_MONOTONIC) passes.
+inline void futex_wait(const std::atomic<uint32_t>& word, uint32_t expected, const timespec* monotonicDeadline) noexcept {
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+    syscall(SYS_futex, &word, FUTEX_WAIT_BITSET_PRIVATE, expected, monotonicDeadline, nullptr, FUTEX_BITSET_MATCH_ANY);
+}
+inline void futex_wake(const std::atomic<uint32_t>& word, int count) noexcept {
+    syscall(SYS_futex, &word, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+#endif
+} // namespace cpt::detail
+
 namespace cpt::clocks {
+// Threads blocked on a deadline in some clock register the word they wait on here, event loops their eventfd,
+// so that pausing, resuming or adjusting the clock can wake them to re-arm their timeouts.
+class change_waiters {
+public:
+    void add(const std::atomic<uint32_t>& word) {
+        std::lock_guard lock(m_mutex);
+        m_words.push_back(&word);
+        m_count.fetch_add(1);
+    }
+    void remove(const std::atomic<uint32_t>& word) {
+        std::lock_guard lock(m_mutex);
+        m_words.erase(std::find(m_words.begin(), m_words.end(), &word));
+        m_count.fetch_sub(1);
+    }
+    void add_eventfd(int fd) {
+        std::lock_guard lock(m_mutex);
+        m_eventFds.push_back(fd);
+        m_count.fetch_add(1);
+    }
+    void remove_eventfd(int fd) {
+        std::lock_guard lock(m_mutex);
+        m_eventFds.erase(std::find(m_eventFds.begin(), m_eventFds.end(), fd));
+        m_count.fetch_sub(1);
+    }
+    // Call after every change of the clock
+    void notify() noexcept {
+#if defined(__linux__)
+        if (m_count.load() == 0)
+            return;
+        std::lock_guard lock(m_mutex);
+        for (const std::atomic<uint32_t>* word : m_words)
+            detail::futex_wake(*word, INT_MAX);
+        const uint64_t one = 1;
+        for (int fd : m_eventFds)
+            [[maybe_unused]] ssize_t written = write(fd, &one, sizeof(one));
+#endif
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<const std::atomic<uint32_t>*> m_words;
+    std::vector<int> m_eventFds;
+    std::atomic<size_t> m_count{0};
+};
+
 // If you want to have different clocks that can be paused, use 'UniqueIdentifier' to differentiate them.
 // Currently, there is no way to create new pauseable_clocks at runtime.
-// TODO: provide multi-threaded variant
+// 'now()' may race with 'pause()' and 'resume()' from other threads, it waits out one that is being written.
 template <typename UniqueIdentifier = void, class BaseClock = std::chrono::steady_clock>
     requires(std::chrono::is_clock_v<BaseClock>)
 struct pauseable_clock_st {
@@ -350,31 +481,1876 @@ struct pauseable_clock_st {
     using time_point = std::chrono::time_point<pauseable_clock_st>;
     static constexpr bool is_steady = false; // can pause
 
-    static constexpr time_point now() noexcept {
-        if (m_paused) {
-            return time_point(m_pauseStartPoint - m_totalPauseDuration);
+    static time_point now() noexcept {
+        while (true) {
+            const uint64_t before = m_control.load(std::memory_order_acquire);
+            if (before & locked) {
+                std::this_thread::yield();
+                continue;
+            }
+            const slot& current = m_slots[(before >> 1) & 1];
+            const bool paused = current.paused.load(std::memory_order_relaxed);
+            const duration pauseStart(current.pauseStart.load(std::memory_order_relaxed));
+            const duration totalPause(current.totalPause.load(std::memory_order_relaxed));
+            // a pause that starts after this reading must not freeze the clock before it
+            const duration base = paused ? pauseStart : BaseClock::now().time_since_epoch();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_control.load(std::memory_order_relaxed) == before)
+                return time_point(base - totalPause);
+        }
+    }
+
+    static void pause() noexcept {
+        const uint64_t generation = lock_writer();
+        const slot& current = m_slots[generation & 1];
+        if (current.paused.load(std::memory_order_relaxed))
+            return m_control.store(generation << 1, std::memory_order_release);
+        // the base clock is read only once readers are held off, so it is later than anything 'now()' returned
+        publish(generation, true, BaseClock::now().time_since_epoch(), duration(current.totalPause.load(std::memory_order_relaxed)));
+        m_waiters.notify();
+    }
+    static void resume() noexcept {
+        const uint64_t generation = lock_writer();
+        const slot& current = m_slots[generation & 1];
+        if (!current.paused.load(std::memory_order_relaxed))
+            return m_control.store(generation << 1, std::memory_order_release);
+        const duration pauseStart(current.pauseStart.load(std::memory_order_relaxed));
+        const duration totalPause(current.totalPause.load(std::memory_order_relaxed));
+        publish(generation, false, pauseStart, totalPause + (BaseClock::now().time_since_epoch() - pauseStart));
+        m_waiters.notify();
+    }
+    static bool is_paused() noexcept {
+        while (true) {
+            const uint64_t before = m_control.load(std::memory_order_acquire);
+            const bool paused = m_slots[(before >> 1) & 1].paused.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((m_control.load(std::memory_order_relaxed) >> 1) == (before >> 1))
+                return paused;
+        }
+    }
+
+    static change_waiters& waiters() noexcept { return m_waiters; }
+
+private:
+    // Full-width values in two slots, a writer only touches the one that is not current.
+    // The control word holds the generation, whose low bit picks the current slot, and the writer lock below it.
+    struct slot {
+        std::atomic<bool> paused{false};
+        std::atomic<rep> pauseStart{};
+        std::atomic<rep> totalPause{};
+    };
+    static constexpr uint64_t locked = 1;
+
+    // Returns the generation that is current while the lock is held
+    static uint64_t lock_writer() noexcept {
+        uint64_t control = m_control.load(std::memory_order_relaxed);
+        while (true) {
+            if (control & locked) {
+                std::this_thread::yield();
+                control = m_control.load(std::memory_order_relaxed);
+            } else if (m_control.compare_exchange_weak(control, control | locked, std::memory_order_acquire)) {
+                return control >> 1;
+            }
+        }
+    }
+    static void publish(uint64_t generation, bool paused, duration pauseStart, duration totalPause) noexcept {
+        slot& to = m_slots[(generation + 1) & 1];
+        to.paused.store(paused, std::memory_order_relaxed);
+        to.pauseStart.store(pauseStart.count(), std::memory_order_relaxed);
+        to.totalPause.store(totalPause.count(), std::memory_order_relaxed);
+        m_control.store((generation + 1) << 1, std::memory_order_release);
+    }
+
+    static inline change_waiters m_waiters;
+    static inline std::atomic<uint64_t> m_control{0};
+    static inline slot m_slots[2];
+};
+
+template <size_t N>
+struct fixed_string {
+    constexpr fixed_string(const char (&string)[N]) noexcept { std::copy_n(string, N, value); }
+    char value[N];
+};
+
+#if defined(__linux__)
+// Pauseable clock whose state lives in the POSIX shared memory segment 'Name' (e.g. "/my_clock"),
+// so every process that uses the same name sees the same timeline. Safe to use from any thread.
+// 'is_paused()' never blocks. 'now()' waits out a 'pause()' or 'resume()' that is being written, but at most 'reader_patience'
+// per stuck writer and process, after that it reads without waiting.
+// A process that dies in the middle of 'pause()' or 'resume()' leaves the clock as it was before the call,
+// its lock is taken over once it has been held for 'abandon_after' by a pid that no longer exists.
+// The segment is attached on first use, call 'attach()' up front to get errors as exceptions.
+template <fixed_string Name, class BaseClock = std::chrono::steady_clock>
+    requires(std::chrono::is_clock_v<BaseClock> && BaseClock::is_steady)
+struct shared_pauseable_clock {
+    using rep = int64_t;
+    using period = BaseClock::period;
+    using duration = std::chrono::duration<rep, period>;
+    using time_point = std::chrono::time_point<shared_pauseable_clock>;
+    static constexpr bool is_steady = false; // can pause
+
+    static constexpr uint64_t layout_magic = 0x6b636f6c63747063; // "cptclock"
+    static constexpr uint32_t layout_version = 2;
+    static constexpr std::chrono::milliseconds reader_patience{1};
+    static constexpr std::chrono::seconds abandon_after{1};
+
+    static time_point now() noexcept {
+        duration base;
+        const snapshot current = read(segment(), &base);
+        if (current.paused)
+            return time_point(duration(current.pauseStart - current.totalPause));
+        return time_point(base - duration(current.totalPause));
+    }
+
+    static void pause() noexcept {
+        shared_state& state = segment();
+        const uint64_t locked = lock_writer(state);
+        snapshot next = load(state.slots[(locked >> 32) & 1]);
+        if (next.paused)
+            return unlock_writer(state, locked);
+        next.paused = 1;
+        next.pauseStart = base_now().count();
+        if (publish(state, locked, next))
+            waiters().notify();
+    }
+    static void resume() noexcept {
+        shared_state& state = segment();
+        const uint64_t locked = lock_writer(state);
+        snapshot next = load(state.slots[(locked >> 32) & 1]);
+        if (!next.paused)
+            return unlock_writer(state, locked);
+        next.paused = 0;
+        next.totalPause += base_now().count() - next.pauseStart;
+        if (publish(state, locked, next))
+            waiters().notify();
+    }
+    static bool is_paused() noexcept { return read(segment()).paused; }
+
+    // Only wakes waiters of this process, waits re-check a paused shared clock periodically.
+    static change_waiters& waiters() noexcept {
+        static change_waiters waiters;
+        return waiters;
+    }
+
+    // Throws std::system_error if the segment can not be created or mapped,
+    // std::runtime_error if it was created with an incompatible layout.
+    static void attach() { segment_or_throw(); }
+    // Removes the name, processes that are already attached keep their mapping.
+    static void unlink() noexcept { shm_unlink(Name.value); }
+
+private:
+    struct slot {
+        std::atomic<int64_t> paused;
+        std::atomic<int64_t> pauseStart;
+        std::atomic<int64_t> totalPause;
+    };
+    struct snapshot {
+        int64_t paused;
+        int64_t pauseStart;
+        int64_t totalPause;
+    };
+    struct shared_state {
+        std::atomic<uint64_t> magic;
+        std::atomic<uint32_t> version;
+        std::atomic<uint64_t> init; // 0 = empty, 'initializing | pid' while being set up, 'ready' after
+
+        // 'generation << 32 | writer pid', pid 0 when unlocked. Slot 'generation & 1' holds the current state,
+        // a writer fills the other one and publishes it by bumping the generation and clearing its pid in one store.
+        alignas(64) std::atomic<uint64_t> control;
+        slot slots[2];
+    };
+    static constexpr uint64_t initializing = uint64_t(1) << 32;
+    static constexpr uint64_t ready = uint64_t(2) << 32;
+    static constexpr uint64_t pid_mask = 0xffffffff;
+    static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<int64_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free);
+
+    static duration base_now() noexcept { return std::chrono::duration_cast<duration>(BaseClock::now().time_since_epoch()); }
+
+    static bool is_dead(int32_t pid) noexcept { return pid > 0 && kill(pid, 0) == -1 && errno == ESRCH; }
+
+    static snapshot load(const slot& from) noexcept {
+        return {from.paused.load(std::memory_order_relaxed), from.pauseStart.load(std::memory_order_relaxed),
+                from.totalPause.load(std::memory_order_relaxed)};
+    }
+
+    // How long the same control word has been seen without a change
+    class lock_watch {
+    public:
+        duration held(uint64_t control) noexcept {
+            const duration now = base_now();
+            if (control != m_control || m_since == duration::min()) {
+                m_control = control;
+                m_since = now;
+            }
+            return now - m_since;
+        }
+
+    private:
+        uint64_t m_control = 0;
+        duration m_since = duration::min();
+    };
+
+    // A writer only touches the slot that is not current, so the read is valid unless a generation was published meanwhile.
+    // With 'base', the base clock is sampled too, and only while no writer holds the lock: a writer samples it after
+    // locking, so a pause can never freeze the clock earlier than a reading that was already returned.
+    // A lock held for longer than 'reader_patience' is remembered as stuck, and not waited for again in this process.
+    static snapshot read(shared_state& state, duration* base = nullptr) noexcept {
+        lock_watch watch;
+        for (uint32_t spins = 1;; spins++) {
+            const uint64_t before = state.control.load(std::memory_order_acquire);
+            const bool waitForWriter = base && (before & pid_mask) != 0 && before != s_stuck.load(std::memory_order_relaxed);
+            if (waitForWriter) {
+                if (spins % 64 == 0 && watch.held(before) >= reader_patience)
+                    s_stuck.store(before, std::memory_order_relaxed);
+                else if (spins % 64 == 0)
+                    std::this_thread::yield();
+                continue;
+            }
+            const snapshot current = load(state.slots[(before >> 32) & 1]);
+            if (base && !current.paused)
+                *base = base_now();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t after = state.control.load(std::memory_order_relaxed);
+            if (base && (before & pid_mask) == 0 ? before == after : (before >> 32) == (after >> 32))
+                return current;
+        }
+    }
+
+    // Returns the control word that holds the lock. The pid is part of the word that takes the lock,
+    // so an owner can always be identified. Its lock is only taken over once the pid is gone and the word
+    // has not changed for 'abandon_after', which guards against pids of other namespaces.
+    static uint64_t lock_writer(shared_state& state) noexcept {
+        const uint64_t pid = uint32_t(getpid());
+        lock_watch watch;
+        for (uint32_t spins = 1;; spins++) {
+            uint64_t control = state.control.load(std::memory_order_relaxed);
+            const uint32_t owner = uint32_t(control & pid_mask);
+            const bool free = owner == 0 || (spins % 1024 == 0 && owner != pid && watch.held(control) >= abandon_after &&
+                                             is_dead(int32_t(owner)));
+            if (free && state.control.compare_exchange_weak(control, (control & ~pid_mask) | pid, std::memory_order_acquire))
+                return (control & ~pid_mask) | pid;
+            if (spins % 1024 == 0)
+                std::this_thread::yield();
+        }
+    }
+    // Both fail if the lock was taken over meanwhile, the update is then dropped.
+    static bool unlock_writer(shared_state& state, uint64_t locked, uint64_t generation) noexcept {
+        return state.control.compare_exchange_strong(locked, generation << 32, std::memory_order_release);
+    }
+    static void unlock_writer(shared_state& state, uint64_t locked) noexcept { unlock_writer(state, locked, locked >> 32); }
+    static bool publish(shared_state& state, uint64_t locked, const snapshot& next) noexcept {
+        const uint64_t generation = locked >> 32;
+        slot& to = state.slots[(generation + 1) & 1];
+        to.paused.store(next.paused, std::memory_order_relaxed);
+        to.pauseStart.store(next.pauseStart, std::memory_order_relaxed);
+        to.totalPause.store(next.totalPause, std::memory_order_relaxed);
+        return unlock_writer(state, locked, uint32_t(generation + 1));
+    }
+
+    // Lock word this process has given up waiting for
+    static inline std::atomic<uint64_t> s_stuck{0};
+
+    static void initialize(shared_state& state) noexcept {
+        for (slot& each : state.slots) {
+            each.paused.store(0, std::memory_order_relaxed);
+            each.pauseStart.store(0, std::memory_order_relaxed);
+            each.totalPause.store(0, std::memory_order_relaxed);
+        }
+        state.control.store(0, std::memory_order_relaxed);
+        state.magic.store(layout_magic, std::memory_order_relaxed);
+        state.version.store(layout_version, std::memory_order_relaxed);
+        state.init.store(ready, std::memory_order_release);
+    }
+
+    static shared_state* segment_or_throw() {
+        static shared_state* const state = map_segment();
+        return state;
+    }
+    static shared_state& segment() noexcept { return *segment_or_throw(); }
+
+    static shared_state* map_segment() {
+        const int fd = shm_open(Name.value, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        if (fd == -1)
+            throw std::system_error(errno, std::generic_category(), "shm_open");
+        // growing from zero fills with zeros, which is the empty state
+        struct stat info;
+        if (fstat(fd, &info) == -1 || (info.st_size < off_t(sizeof(shared_state)) && ftruncate(fd, sizeof(shared_state)) == -1)) {
+            const int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "shm size");
+        }
+        void* memory = mmap(nullptr, sizeof(shared_state), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), "mmap");
+        shared_state& state = *static_cast<shared_state*>(memory);
+
+        // state and owner are claimed together, so a crash at any point leaves a recoverable segment
+        const uint64_t claim = initializing | uint32_t(getpid());
+        while (true) {
+            uint64_t init = state.init.load(std::memory_order_acquire);
+            if (init == ready)
+                break;
+            // empty, or the initializing process crashed
+            if ((init == 0 || is_dead(int32_t(init & 0xffffffff))) &&
+                state.init.compare_exchange_strong(init, claim, std::memory_order_acquire)) {
+                initialize(state);
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        if (state.magic.load(std::memory_order_relaxed) != layout_magic ||
+            state.version.load(std::memory_order_relaxed) != layout_version) {
+            munmap(memory, sizeof(shared_state));
+            throw std::runtime_error("shared_pauseable_clock: incompatible shared memory layout");
+        }
+        return &state;
+    }
+};
+#endif
+
+// Time cached by the kernel at the last scheduler tick. Much cheaper to read than steady_clock,
+// but only advances in steps of a few milliseconds. Same epoch as steady_clock on Linux.
+struct coarse_clock {
+    using rep = int64_t;
+    using period = std::nano;
+    using duration = std::chrono::duration<rep, period>;
+    using time_point = std::chrono::time_point<coarse_clock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept {
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+        return time_point(duration(now.tv_sec * rep(1'000'000'000) + now.tv_nsec));
+#else
+        return time_point(std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()));
+#endif
+    }
+};
+
+// Clocks that can be stopped. While paused, no deadline expressed in such a clock can be reached.
+template <class Clock>
+concept pauseable = std::chrono::is_clock_v<Clock> && requires {
+    { Clock::is_paused() } -> std::convertible_to<bool>;
+};
+
+// Clocks that wake registered waiters when they are paused, resumed or adjusted.
+template <class Clock>
+concept notifies_changes = std::chrono::is_clock_v<Clock> && requires {
+    { Clock::waiters() } -> std::same_as<change_waiters&>;
+};
+} // namespace cpt::clocks
+namespace cpt {
+template <class T = void>
+class task;
+class event_loop;
+
+namespace detail {
+struct task_promise_base {
+    struct final_awaiter {
+        constexpr bool await_ready() const noexcept { return false; }
+        template <class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            return handle.promise().m_continuation;
+        }
+        constexpr void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    final_awaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { m_exception = std::current_exception(); }
+
+    std::coroutine_handle<> m_continuation = std::noop_coroutine();
+    std::exception_ptr m_exception;
+};
+
+template <class T>
+struct task_promise : task_promise_base {
+    task<T> get_return_object() noexcept;
+    template <class U>
+        requires(std::is_convertible_v<U &&, T>)
+    void return_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, U&&>) {
+        m_value.emplace(std::forward<U>(value));
+    }
+    T result() {
+        if (m_exception)
+            std::rethrow_exception(m_exception);
+        return std::move(*m_value);
+    }
+
+    std::optional<T> m_value;
+};
+
+template <>
+struct task_promise<void> : task_promise_base {
+    task<void> get_return_object() noexcept;
+    void return_void() const noexcept {}
+    void result() const {
+        if (m_exception)
+            std::rethrow_exception(m_exception);
+    }
+};
+
+template <class Awaitable>
+decltype(auto) get_awaiter(Awaitable&& awaitable) {
+    if constexpr (requires { std::forward<Awaitable>(awaitable).operator co_await(); })
+        return std::forward<Awaitable>(awaitable).operator co_await();
+    else if constexpr (requires { operator co_await(std::forward<Awaitable>(awaitable)); })
+        return operator co_await(std::forward<Awaitable>(awaitable));
+    else
+        return std::forward<Awaitable>(awaitable);
+}
+template <class Awaitable>
+using await_result_t = decltype(get_awaiter(std::declval<Awaitable>()).await_resume());
+} // namespace detail
+
+// Lazily started coroutine. Starts running when awaited, resumes the awaiter when done.
+template <class T>
+class task {
+public:
+    using promise_type = detail::task_promise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    constexpr task() noexcept = default;
+    explicit task(handle_type handle) noexcept : m_handle(handle) {}
+    task(task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    task& operator=(task&& other) noexcept {
+        if (this != &other) {
+            if (m_handle)
+                m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+    ~task() {
+        if (m_handle)
+            m_handle.destroy();
+    }
+
+    bool done() const noexcept { return !m_handle || m_handle.done(); }
+
+    auto operator co_await() && noexcept {
+        struct awaiter {
+            bool await_ready() const noexcept { return !m_handle || m_handle.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+                m_handle.promise().m_continuation = continuation;
+                return m_handle;
+            }
+            T await_resume() { return m_handle.promise().result(); }
+
+            handle_type m_handle;
+        };
+        return awaiter{m_handle};
+    }
+
+private:
+    handle_type m_handle = nullptr;
+};
+
+template <class T>
+task<T> detail::task_promise<T>::get_return_object() noexcept {
+    return task<T>(std::coroutine_handle<task_promise>::from_promise(*this));
+}
+inline task<void> detail::task_promise<void>::get_return_object() noexcept {
+    return task<void>(std::coroutine_handle<task_promise>::from_promise(*this));
+}
+
+namespace detail {
+class timer_queue_base {
+public:
+    using steady_point = std::chrono::steady_clock::time_point;
+
+    virtual ~timer_queue_base() = default;
+    // Earliest pending deadline converted to steady_clock, empty when nothing is pending.
+    // While the clock is paused, the time to check it again.
+    virtual std::optional<steady_point> next_deadline(steady_point steadyNow) = 0;
+    virtual void collect_expired(std::vector<std::coroutine_handle<>>& ready) = 0;
+    virtual bool cancel(uint64_t id) = 0;
+    size_t live() const noexcept { return m_live; }
+
+protected:
+    size_t m_live = 0;
+};
+
+// A paused clock can be resumed where no notification reaches the loop, e.g. from another process.
+inline constexpr std::chrono::milliseconds paused_clock_recheck{10};
+
+template <class Clock>
+class timer_queue final : public timer_queue_base {
+public:
+    // 'wakeFd' is signalled whenever the clock announces a change, -1 for none
+    explicit timer_queue(int wakeFd) : m_wakeFd(wakeFd) {
+        if constexpr (clocks::notifies_changes<Clock>) {
+            if (m_wakeFd != -1)
+                Clock::waiters().add_eventfd(m_wakeFd);
+        }
+    }
+    timer_queue(const timer_queue&) = delete;
+    timer_queue& operator=(const timer_queue&) = delete;
+    ~timer_queue() override {
+        if constexpr (clocks::notifies_changes<Clock>) {
+            if (m_wakeFd != -1)
+                Clock::waiters().remove_eventfd(m_wakeFd);
+        }
+    }
+
+    void add(typename Clock::time_point deadline, uint64_t id, std::coroutine_handle<> handle, bool cancellable) {
+        m_heap.push_back({deadline.time_since_epoch().count(), id, handle, cancellable});
+        std::push_heap(m_heap.begin(), m_heap.end(), later);
+        if (cancellable)
+            m_cancellable.insert(id);
+        m_live++;
+    }
+
+    std::optional<steady_point> next_deadline(steady_point steadyNow) override {
+        drop_cancelled();
+        if (m_heap.empty())
+            return std::nullopt;
+        if constexpr (clocks::pauseable<Clock>) {
+            if (Clock::is_paused())
+                return steadyNow + paused_clock_recheck;
+        }
+        if constexpr (std::is_same_v<Clock, std::chrono::steady_clock>) {
+            return steady_point(typename Clock::duration(m_heap.front().deadline));
         } else {
-            return time_point(BaseClock::now().time_since_epoch() - m_totalPauseDuration);
+            typename Clock::duration remaining = typename Clock::duration(m_heap.front().deadline) - Clock::now().time_since_epoch();
+            return steadyNow + std::chrono::ceil<std::chrono::steady_clock::duration>(remaining);
         }
     }
 
-    static constexpr void pause() noexcept {
-        if (m_paused)
+    void collect_expired(std::vector<std::coroutine_handle<>>& ready) override {
+        drop_cancelled();
+        if (m_heap.empty())
             return;
-        m_pauseStartPoint = BaseClock::now().time_since_epoch();
-        m_paused = true;
+        if constexpr (clocks::pauseable<Clock>) {
+            if (Clock::is_paused())
+                return;
+        }
+        const typename Clock::rep now = Clock::now().time_since_epoch().count();
+        while (!m_heap.empty() && m_heap.front().deadline <= now) {
+            std::pop_heap(m_heap.begin(), m_heap.end(), later);
+            entry expired = m_heap.back();
+            m_heap.pop_back();
+            if (expired.cancellable && m_cancelled.erase(expired.id))
+                continue;
+            if (expired.cancellable)
+                m_cancellable.erase(expired.id);
+            m_live--;
+            ready.push_back(expired.handle);
+        }
+    }
+
+    // Returns false if the timer has already fired.
+    bool cancel(uint64_t id) override {
+        if (!m_cancellable.erase(id))
+            return false;
+        m_cancelled.insert(id);
+        m_live--;
+        return true;
+    }
+
+private:
+    struct entry {
+        typename Clock::rep deadline;
+        uint64_t id;
+        std::coroutine_handle<> handle;
+        bool cancellable;
+    };
+    static bool later(const entry& lhs, const entry& rhs) noexcept {
+        return lhs.deadline != rhs.deadline ? lhs.deadline > rhs.deadline : lhs.id > rhs.id;
+    }
+
+    void drop_cancelled() {
+        while (!m_cancelled.empty() && !m_heap.empty() && m_heap.front().cancellable && m_cancelled.contains(m_heap.front().id)) {
+            m_cancelled.erase(m_heap.front().id);
+            std::pop_heap(m_heap.begin(), m_heap.end(), later);
+            m_heap.pop_back();
+        }
+    }
+
+    const int m_wakeFd;
+    std::vector<entry> m_heap;
+    std::unordered_set<uint64_t> m_cancellable;
+    std::unordered_set<uint64_t> m_cancelled;
+};
+
+struct loop_root {
+    struct promise_type;
+    struct final_awaiter {
+        constexpr bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+        constexpr void await_resume() const noexcept {}
+    };
+    struct promise_type {
+        loop_root get_return_object() noexcept { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        final_awaiter final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        // Spawned tasks have nobody to report to
+        void unhandled_exception() const noexcept { std::terminate(); }
+
+        event_loop* m_loop = nullptr;
+    };
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+} // namespace detail
+
+// Single-threaded run loop that resumes coroutines when their timers expire.
+// Timers on pauseable clocks do not fire while their clock is paused.
+// Must only be driven from one thread, only 'stop()' may be called from elsewhere.
+class event_loop {
+public:
+    // Throws std::system_error if the epoll, timer or wake descriptors can not be set up.
+    event_loop() {
+#if defined(__linux__)
+        auto check = [this](bool ok, const char* what) {
+            if (ok)
+                return;
+            const int error = errno;
+            close_descriptors();
+            throw std::system_error(error, std::generic_category(), what);
+        };
+        m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+        check(m_epollFd != -1, "epoll_create1");
+        m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        check(m_timerFd != -1, "timerfd_create");
+        m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        check(m_wakeFd != -1, "eventfd");
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = m_timerFd;
+        check(epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_timerFd, &event) == 0, "epoll_ctl");
+        event.data.fd = m_wakeFd;
+        check(epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event) == 0, "epoll_ctl");
+#endif
+    }
+    event_loop(const event_loop&) = delete;
+    event_loop& operator=(const event_loop&) = delete;
+    ~event_loop() {
+        // destroying a root destroys the whole chain of tasks it is awaiting
+        for (void* root : m_roots)
+            std::coroutine_handle<>::from_address(root).destroy();
+        // unsubscribes from clock changes before the wake descriptor goes away
+        m_queues.clear();
+#if defined(__linux__)
+        close_descriptors();
+#endif
+    }
+
+    // Loop that is currently running on this thread, nullptr if none.
+    static event_loop* current() noexcept { return s_current; }
+
+    void spawn(task<void> work) {
+        std::coroutine_handle<detail::loop_root::promise_type> root = make_root(std::move(work)).m_handle;
+        root.promise().m_loop = this;
+        m_roots.insert(root.address());
+        m_ready.push_back(root);
+    }
+
+    // Runs until stopped, or until no coroutine is ready and no timer is pending.
+    // Timers on a paused clock keep it waiting, it wakes up as soon as the clock is resumed from any thread.
+    void run() {
+        event_loop* previous = std::exchange(s_current, this);
+        while (!m_stopRequested.load(std::memory_order_relaxed)) {
+            if (m_liveTimers != 0)
+                collect_expired();
+            if (!m_ready.empty()) {
+                m_batch.swap(m_ready);
+                for (std::coroutine_handle<> handle : m_batch)
+                    handle.resume();
+                m_batch.clear();
+                continue;
+            }
+            if (m_liveTimers == 0)
+                break;
+            std::optional<std::chrono::steady_clock::time_point> deadline = next_deadline();
+            if (!deadline)
+                break;
+            wait_until(*deadline);
+        }
+        m_stopRequested.store(false, std::memory_order_relaxed);
+        s_current = previous;
+    }
+
+    // Thread-safe
+    void stop() noexcept {
+        m_stopRequested.store(true, std::memory_order_relaxed);
+#if defined(__linux__)
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t written = write(m_wakeFd, &one, sizeof(one));
+#endif
+    }
+
+    void schedule(std::coroutine_handle<> handle) { m_ready.push_back(handle); }
+
+    template <class Clock>
+    uint64_t add_timer(typename Clock::time_point deadline, std::coroutine_handle<> handle, bool cancellable = false) {
+        uint64_t id = m_nextTimerId++;
+        queue<Clock>().add(deadline, id, handle, cancellable);
+        m_liveTimers++;
+        return id;
+    }
+    // Only timers added as cancellable can be cancelled. Returns false if the timer has already fired.
+    template <class Clock>
+    bool cancel_timer(uint64_t id) {
+        if (!queue<Clock>().cancel(id))
+            return false;
+        m_liveTimers--;
+        return true;
+    }
+
+    size_t pending_timers() const noexcept { return m_liveTimers; }
+
+private:
+    friend struct detail::loop_root::final_awaiter;
+
+    static detail::loop_root make_root(task<void> work) { co_await std::move(work); }
+
+    template <class Clock>
+    detail::timer_queue<Clock>& queue() {
+        const std::type_index type = typeid(Clock);
+        for (auto& [queueType, queue] : m_queues) {
+            if (queueType == type)
+                return static_cast<detail::timer_queue<Clock>&>(*queue);
+        }
+#if defined(__linux__)
+        m_queues.emplace_back(type, std::make_unique<detail::timer_queue<Clock>>(m_wakeFd));
+#else
+        m_queues.emplace_back(type, std::make_unique<detail::timer_queue<Clock>>(-1));
+#endif
+        return static_cast<detail::timer_queue<Clock>&>(*m_queues.back().second);
+    }
+
+    void collect_expired() {
+        for (auto& [type, queue] : m_queues) {
+            size_t before = queue->live();
+            queue->collect_expired(m_ready);
+            m_liveTimers -= before - queue->live();
+        }
+    }
+
+    std::optional<std::chrono::steady_clock::time_point> next_deadline() {
+        const std::chrono::steady_clock::time_point steadyNow = std::chrono::steady_clock::now();
+        std::optional<std::chrono::steady_clock::time_point> earliest;
+        for (auto& [type, queue] : m_queues) {
+            std::optional<std::chrono::steady_clock::time_point> deadline = queue->next_deadline(steadyNow);
+            if (deadline && (!earliest || *deadline < *earliest))
+                earliest = deadline;
+        }
+        return earliest;
+    }
+
+    void wait_until(std::chrono::steady_clock::time_point deadline) {
+#if defined(__linux__)
+        if (deadline != m_armedDeadline) {
+            const std::chrono::nanoseconds sinceEpoch = std::max(deadline.time_since_epoch(), std::chrono::steady_clock::duration(1));
+            itimerspec spec{};
+            spec.it_value.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch).count();
+            spec.it_value.tv_nsec = (sinceEpoch % std::chrono::seconds(1)).count();
+            timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+            m_armedDeadline = deadline;
+        }
+        epoll_event events[2];
+        int count = epoll_wait(m_epollFd, events, 2, -1);
+        for (int i = 0; i < count; i++) {
+            uint64_t value;
+            [[maybe_unused]] ssize_t bytes = read(events[i].data.fd, &value, sizeof(value));
+            if (events[i].data.fd == m_timerFd)
+                m_armedDeadline = {};
+        }
+#else
+        std::this_thread::sleep_until(deadline);
+#endif
+    }
+
+#if defined(__linux__)
+    void close_descriptors() noexcept {
+        for (int* fd : {&m_wakeFd, &m_timerFd, &m_epollFd}) {
+            if (*fd != -1)
+                close(std::exchange(*fd, -1));
+        }
+    }
+#endif
+
+    static inline thread_local event_loop* s_current = nullptr;
+
+    std::vector<std::coroutine_handle<>> m_ready;
+    std::vector<std::coroutine_handle<>> m_batch;
+    std::vector<std::pair<std::type_index, std::unique_ptr<detail::timer_queue_base>>> m_queues;
+    std::unordered_set<void*> m_roots;
+    uint64_t m_nextTimerId = 0;
+    size_t m_liveTimers = 0;
+    std::atomic<bool> m_stopRequested{false};
+#if defined(__linux__)
+    int m_epollFd = -1;
+    int m_timerFd = -1;
+    int m_wakeFd = -1;
+    std::chrono::steady_clock::time_point m_armedDeadline{};
+#endif
+};
+
+inline void detail::loop_root::final_awaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+    handle.promise().m_loop->m_roots.erase(handle.address());
+    handle.destroy();
+}
+
+// Must be awaited from a coroutine running on an 'event_loop'.
+template <class Clock>
+class sleep_awaiter {
+public:
+    explicit sleep_awaiter(typename Clock::time_point deadline) noexcept : m_deadline(deadline) {}
+
+    bool await_ready() const noexcept { return Clock::now() >= m_deadline; }
+    void await_suspend(std::coroutine_handle<> handle) const { event_loop::current()->add_timer<Clock>(m_deadline, handle); }
+    constexpr void await_resume() const noexcept {}
+
+private:
+    typename Clock::time_point m_deadline;
+};
+
+template <class Clock>
+sleep_awaiter<Clock> sleep_until(const time_point<Clock>& deadline) noexcept {
+    return sleep_awaiter<Clock>(deadline);
+}
+template <class Clock, class Duration>
+sleep_awaiter<Clock> sleep_until(const std::chrono::time_point<Clock, Duration>& deadline) noexcept {
+    return sleep_awaiter<Clock>(time_point<Clock>(deadline));
+}
+template <class Clock = std::chrono::steady_clock>
+sleep_awaiter<Clock> sleep_for(const time_duration& duration) noexcept {
+    return sleep_awaiter<Clock>(time_point<Clock>() + duration);
+}
+
+// Lets other ready coroutines on the same 'event_loop' run first.
+inline auto yield() noexcept {
+    struct awaiter {
+        constexpr bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) const { event_loop::current()->schedule(handle); }
+        constexpr void await_resume() const noexcept {}
+    };
+    return awaiter{};
+}
+
+namespace detail {
+template <class T>
+struct timeout_value {
+    std::optional<T> m_value;
+};
+template <>
+struct timeout_value<void> {};
+
+template <class T>
+struct timeout_state : timeout_value<T> {
+    std::exception_ptr m_exception;
+    std::coroutine_handle<> m_waiter;
+    uint64_t m_timerId = 0;
+    bool m_finished = false;  // either completed or timed out, whichever came first
+    bool m_completed = false; // the awaitable won
+};
+
+template <class Clock, class T, class Awaitable>
+task<void> timeout_child(Awaitable awaitable, std::shared_ptr<timeout_state<T>> state) {
+    std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> value;
+    std::exception_ptr exception;
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await std::move(awaitable);
+            value.emplace(true);
+        } else {
+            value.emplace(co_await std::move(awaitable));
+        }
+    } catch (...) {
+        exception = std::current_exception();
+    }
+    if (state->m_finished)
+        co_return;
+    state->m_finished = true;
+    state->m_completed = true;
+    state->m_exception = exception;
+    if constexpr (!std::is_void_v<T>) {
+        if (value)
+            state->m_value.emplace(std::move(*value));
+    }
+    // if the timer already fired, the waiter is already scheduled
+    if (event_loop::current()->cancel_timer<Clock>(state->m_timerId))
+        event_loop::current()->schedule(state->m_waiter);
+}
+
+template <class Clock, class T>
+struct timeout_awaiter {
+    constexpr bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        event_loop* loop = event_loop::current();
+        m_state->m_waiter = handle;
+        m_state->m_timerId = loop->add_timer<Clock>(m_deadline, handle, true);
+        loop->spawn(std::move(m_child));
+    }
+    constexpr void await_resume() const noexcept {}
+
+    std::shared_ptr<timeout_state<T>> m_state;
+    typename Clock::time_point m_deadline;
+    task<void> m_child;
+};
+} // namespace detail
+
+// Races 'awaitable' against a timer. Yields std::optional of the result, or bool for void awaitables,
+// empty/false on timeout. A timed out awaitable is not cancelled, it keeps running and its result is discarded.
+template <class Clock = std::chrono::steady_clock, class Awaitable, class T = detail::await_result_t<Awaitable>>
+task<std::conditional_t<std::is_void_v<T>, bool, std::optional<T>>> with_timeout(Awaitable awaitable, time_duration timeout) {
+    auto state = std::make_shared<detail::timeout_state<T>>();
+    const typename Clock::time_point deadline = time_point<Clock>() + timeout;
+    detail::timeout_awaiter<Clock, T> race{state, deadline, detail::timeout_child<Clock, T>(std::move(awaitable), state)};
+    co_await race;
+    if (!state->m_finished) {
+        state->m_finished = true;
+        if constexpr (std::is_void_v<T>)
+            co_return false;
+        else
+            co_return std::nullopt;
+    }
+    if (state->m_exception)
+        std::rethrow_exception(state->m_exception);
+    if constexpr (std::is_void_v<T>)
+        co_return true;
+    else
+        co_return std::move(state->m_value);
+}
+} // namespace cpt
+
+namespace cpt {
+// Fixed-size pool. Every worker owns a queue; idle workers steal from the others.
+class thread_pool {
+public:
+    explicit thread_pool(size_t threads = std::max(1u, std::thread::hardware_concurrency())) {
+        for (size_t i = 0; i < threads; i++)
+            m_queues.push_back(std::make_unique<worker_queue>());
+        for (size_t i = 0; i < threads; i++)
+            m_threads.emplace_back(&thread_pool::worker, this, i);
+    }
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+    // Finishes all submitted jobs before returning
+    ~thread_pool() {
+        {
+            std::lock_guard lock(m_sleepMutex);
+            m_stopping = true;
+        }
+        m_sleepCondition.notify_all();
+        for (std::thread& thread : m_threads)
+            thread.join();
+    }
+
+    // Jobs submitted from a worker go to its own queue, others are spread round-robin.
+    void submit(std::function<void()> job) {
+        const size_t index = s_owner == this ? s_index : m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+        // counted before it becomes visible, so a thief's decrement can never run ahead of it
+        m_pending.fetch_add(1);
+        {
+            std::lock_guard lock(m_queues[index]->mutex);
+            m_queues[index]->jobs.push_back(std::move(job));
+        }
+        if (m_sleeping.load() != 0) {
+            std::lock_guard lock(m_sleepMutex);
+            m_sleepCondition.notify_one();
+        }
+    }
+
+    size_t size() const noexcept { return m_threads.size(); }
+
+private:
+    struct alignas(64) worker_queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    bool try_pop(size_t index, std::function<void()>& job) {
+        {
+            worker_queue& own = *m_queues[index];
+            std::lock_guard lock(own.mutex);
+            if (!own.jobs.empty()) {
+                job = std::move(own.jobs.back());
+                own.jobs.pop_back();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < m_queues.size(); i++) {
+            worker_queue& victim = *m_queues[(index + i) % m_queues.size()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.jobs.empty()) {
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker(size_t index) {
+        s_owner = this;
+        s_index = index;
+        std::function<void()> job;
+        while (true) {
+            if (try_pop(index, job)) {
+                m_pending.fetch_sub(1);
+                job();
+                job = nullptr;
+                continue;
+            }
+            std::unique_lock lock(m_sleepMutex);
+            m_sleeping.fetch_add(1);
+            m_sleepCondition.wait(lock, [this] { return m_pending.load() != 0 || m_stopping; });
+            m_sleeping.fetch_sub(1);
+            if (m_stopping && m_pending.load() == 0)
+                return;
+        }
+    }
+
+    static inline thread_local thread_pool* s_owner = nullptr;
+    static inline thread_local size_t s_index = 0;
+
+    std::vector<std::unique_ptr<worker_queue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::atomic<size_t> m_nextQueue{0};
+    std::atomic<size_t> m_pending{0};
+    std::atomic<size_t> m_sleeping{0};
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCondition;
+    bool m_stopping = false;
+};
+
+// What to do when a periodic task falls one or more periods behind.
+enum class missed_tick_policy {
+    skip,     // drop missed ticks, continue at the next tick in the future
+    catch_up, // run every missed tick back to back
+    coalesce, // run once for all missed ticks, then continue on schedule
+};
+
+struct lateness_stats {
+    uint64_t count = 0;
+    uint64_t failures = 0; // runs whose body threw
+    time_duration min;
+    time_duration max;
+    time_duration mean;
+    time_duration last;
+};
+
+// Runs tasks periodically on a thread_pool. Ticks are scheduled at absolute points 'first + n * period',
+// so lateness of one run never shifts the following ones. A task never overlaps with itself.
+template <class Clock = std::chrono::steady_clock>
+    requires(std::chrono::is_clock_v<Clock>)
+class periodic_executor {
+public:
+    using task_id = uint64_t;
+
+    explicit periodic_executor(thread_pool& pool) : m_pool(pool), m_scheduler(&periodic_executor::scheduler, this) {}
+    periodic_executor(const periodic_executor&) = delete;
+    periodic_executor& operator=(const periodic_executor&) = delete;
+    // Waits for running task bodies, ticks that are not due yet are dropped
+    ~periodic_executor() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wakeup.notify_all();
+        m_scheduler.join();
+        std::unique_lock lock(m_mutex);
+        m_idle.wait(lock, [this] { return m_inFlight == 0; });
+    }
+
+    task_id schedule(time_duration period, std::function<void()> body, missed_tick_policy policy = missed_tick_policy::skip) {
+        return schedule(period, std::move(body), policy, time_point<Clock>() + period);
+    }
+    // Throws std::invalid_argument if 'period' is not positive in 'Clock' ticks.
+    task_id schedule(time_duration period, std::function<void()> body, missed_tick_policy policy, const time_point<Clock>& first) {
+        auto state = std::make_shared<task_state>();
+        state->period = std::chrono::duration_cast<typename Clock::duration>(period.chrono());
+        if (state->period <= Clock::duration::zero())
+            throw std::invalid_argument("periodic_executor::schedule: period must be positive");
+        state->body = std::move(body);
+        state->policy = policy;
+        std::lock_guard lock(m_mutex);
+        state->id = m_nextId++;
+        m_tasks.emplace(state->id, state);
+        push(first.chrono(), std::move(state));
+        return m_nextId - 1;
+    }
+
+    // A run that is already in progress finishes, but is not rescheduled.
+    bool cancel(task_id id) {
+        std::lock_guard lock(m_mutex);
+        auto it = m_tasks.find(id);
+        if (it == m_tasks.end())
+            return false;
+        it->second->cancelled = true;
+        m_tasks.erase(it);
+        return true;
+    }
+
+    // Lateness is the time between a tick and the start of its run.
+    std::optional<lateness_stats> stats(task_id id) const {
+        std::shared_ptr<task_state> state = find(id);
+        if (!state)
+            return std::nullopt;
+        std::lock_guard lock(state->statsMutex);
+        lateness_stats stats;
+        stats.count = state->count;
+        stats.failures = state->failures;
+        if (state->count != 0) {
+            stats.min = state->minLateness;
+            stats.max = state->maxLateness;
+            stats.mean = time_duration(state->totalLateness / static_cast<int64_t>(state->count));
+            stats.last = state->lastLateness;
+        }
+        return stats;
+    }
+
+    // A body that throws keeps its schedule, the exception of its latest failed run is kept here.
+    std::exception_ptr last_error(task_id id) const {
+        std::shared_ptr<task_state> state = find(id);
+        if (!state)
+            return nullptr;
+        std::lock_guard lock(state->statsMutex);
+        return state->lastError;
+    }
+
+    size_t size() const {
+        std::lock_guard lock(m_mutex);
+        return m_tasks.size();
+    }
+
+private:
+    struct task_state {
+        task_id id = 0;
+        typename Clock::duration period{};
+        std::function<void()> body;
+        missed_tick_policy policy = missed_tick_policy::skip;
+        std::atomic<bool> cancelled{false};
+
+        std::mutex statsMutex;
+        uint64_t count = 0;
+        typename Clock::duration totalLateness{};
+        typename Clock::duration minLateness{};
+        typename Clock::duration maxLateness{};
+        typename Clock::duration lastLateness{};
+        uint64_t failures = 0;
+        std::exception_ptr lastError;
+    };
+    struct tick {
+        typename Clock::time_point target;
+        std::shared_ptr<task_state> state;
+    };
+    static bool later(const tick& lhs, const tick& rhs) noexcept { return lhs.target > rhs.target; }
+
+    std::shared_ptr<task_state> find(task_id id) const {
+        std::lock_guard lock(m_mutex);
+        auto it = m_tasks.find(id);
+        return it == m_tasks.end() ? nullptr : it->second;
+    }
+
+    // m_mutex must be held
+    void push(typename Clock::time_point target, std::shared_ptr<task_state> state) {
+        const bool earliest = m_ticks.empty() || target < m_ticks.front().target;
+        m_ticks.push_back({target, std::move(state)});
+        std::push_heap(m_ticks.begin(), m_ticks.end(), later);
+        if (earliest)
+            m_wakeup.notify_one();
+    }
+
+    void scheduler() {
+        std::unique_lock lock(m_mutex);
+        while (!m_stopping) {
+            if (m_ticks.empty()) {
+                m_wakeup.wait(lock);
+                continue;
+            }
+            const typename Clock::time_point now = Clock::now();
+            if (m_ticks.front().target > now) {
+                // converted every time, so a paused or adjusted clock is picked up after the wait
+                m_wakeup.wait_for(lock, m_ticks.front().target - now);
+                continue;
+            }
+            std::pop_heap(m_ticks.begin(), m_ticks.end(), later);
+            tick due = std::move(m_ticks.back());
+            m_ticks.pop_back();
+            if (due.state->cancelled)
+                continue;
+            m_inFlight++;
+            m_pool.submit([this, due = std::move(due)] { run(due.target, due.state); });
+        }
+    }
+
+    void run(typename Clock::time_point target, const std::shared_ptr<task_state>& state) {
+        const typename Clock::duration lateness = Clock::now() - target;
+        {
+            std::lock_guard lock(state->statsMutex);
+            state->minLateness = state->count == 0 ? lateness : std::min(state->minLateness, lateness);
+            state->maxLateness = state->count == 0 ? lateness : std::max(state->maxLateness, lateness);
+            state->totalLateness += lateness;
+            state->lastLateness = lateness;
+            state->count++;
+        }
+        try {
+            state->body();
+        } catch (...) {
+            std::lock_guard lock(state->statsMutex);
+            state->failures++;
+            state->lastError = std::current_exception();
+        }
+
+        typename Clock::time_point next = target + state->period;
+        const typename Clock::time_point now = Clock::now();
+        if (next <= now && state->policy != missed_tick_policy::catch_up) {
+            const auto missed = (now - next) / state->period;
+            next += state->period * missed; // latest tick that is already due
+            if (state->policy == missed_tick_policy::skip)
+                next += state->period;
+        }
+
+        std::lock_guard lock(m_mutex);
+        if (!state->cancelled && !m_stopping)
+            push(next, state);
+        if (--m_inFlight == 0)
+            m_idle.notify_all();
+    }
+
+    thread_pool& m_pool;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::condition_variable m_idle;
+    std::vector<tick> m_ticks;
+    std::unordered_map<task_id, std::shared_ptr<task_state>> m_tasks;
+    task_id m_nextId = 0;
+    size_t m_inFlight = 0;
+    bool m_stopping = false;
+    std::thread m_scheduler;
+};
+} // namespace cpt
+
+namespace cpt {
+// Detects threads that stopped calling 'beat()' for longer than a threshold.
+// Workers only ever touch their own cache line, a single monitor thread does the scanning.
+// With a pauseable clock, stalls are measured in that clock and nothing is reported while it is paused.
+// With coarse_clock both the beat and the scan read a time that lags by up to one kernel tick,
+// so a stall can be reported up to one tick before it really reaches the threshold.
+template <class Clock = clocks::coarse_clock>
+    requires(std::chrono::is_clock_v<Clock>)
+class watchdog {
+public:
+    class alignas(64) heartbeat {
+    public:
+        heartbeat(uint64_t id, std::thread::id thread) noexcept
+            : m_last(Clock::now().time_since_epoch().count()), m_id(id), m_thread(thread) {}
+        heartbeat(const heartbeat&) = delete;
+        heartbeat& operator=(const heartbeat&) = delete;
+
+        void beat() noexcept { m_last.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed); }
+
+        uint64_t id() const noexcept { return m_id; }
+        std::thread::id thread() const noexcept { return m_thread; }
+        time_point<Clock> last_beat() const noexcept {
+            return typename Clock::duration(m_last.load(std::memory_order_relaxed));
+        }
+
+    private:
+        friend class watchdog;
+
+        std::atomic<typename Clock::rep> m_last;
+        const uint64_t m_id;
+        const std::thread::id m_thread;
+    };
+    static_assert(sizeof(heartbeat) == 64);
+
+    // Called on the monitor thread, must not add or remove heartbeats.
+    using handler_type = std::function<void(const heartbeat&, time_duration)>;
+
+    watchdog(time_duration threshold, time_duration scanInterval, handler_type handler)
+        : m_threshold(std::chrono::duration_cast<typename Clock::duration>(threshold.chrono())), m_scanInterval(scanInterval),
+          m_handler(std::move(handler)), m_monitor(&watchdog::monitor, this) {}
+    watchdog(const watchdog&) = delete;
+    watchdog& operator=(const watchdog&) = delete;
+    ~watchdog() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wakeup.notify_all();
+        m_monitor.join();
+    }
+
+    // Registers the calling thread. The heartbeat stays valid until removed or the watchdog is destroyed.
+    heartbeat& add() {
+        std::lock_guard lock(m_mutex);
+        m_slots.push_back(std::make_unique<slot>(m_nextId++, std::this_thread::get_id()));
+        return m_slots.back()->beat;
+    }
+    void remove(const heartbeat& beat) {
+        std::lock_guard lock(m_mutex);
+        std::erase_if(m_slots, [&beat](const std::unique_ptr<slot>& slot) { return &slot->beat == &beat; });
+    }
+
+private:
+    struct slot {
+        slot(uint64_t id, std::thread::id thread) noexcept : beat(id, thread) {}
+
+        heartbeat beat;
+        typename Clock::rep reportedBeat = -1; // monitor only, on its own cache line
+    };
+
+    void monitor() {
+        std::unique_lock lock(m_mutex);
+        while (!m_wakeup.wait_for(lock, m_scanInterval.chrono(), [this] { return m_stopping; })) {
+            if constexpr (clocks::pauseable<Clock>) {
+                if (Clock::is_paused())
+                    continue;
+            }
+            const typename Clock::rep now = Clock::now().time_since_epoch().count();
+            for (const std::unique_ptr<slot>& slot : m_slots) {
+                const typename Clock::rep last = slot->beat.m_last.load(std::memory_order_relaxed);
+                const typename Clock::duration stall(now - last);
+                // report every stall once
+                if (stall > m_threshold && slot->reportedBeat != last) {
+                    slot->reportedBeat = last;
+                    m_handler(slot->beat, stall);
+                }
+            }
+        }
+    }
+
+    const typename Clock::duration m_threshold;
+    const time_duration m_scanInterval;
+    handler_type m_handler;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::vector<std::unique_ptr<slot>> m_slots;
+    uint64_t m_nextId = 0;
+    bool m_stopping = false;
+    std::thread m_monitor;
+};
+} // namespace cpt
+
+namespace cpt {
+// Counts events in a ring of fixed-width time buckets. Writers are spread over cache-line-aligned shards,
+// buckets are advanced lazily by whoever writes to them first. Adding to a bucket is a single CAS,
+// only the first writer of a new bucket briefly marks its slot while resetting it.
+// The default clock is cheap enough to read on every event, or pass a time point you already have.
+// A shard's count per bucket saturates at 2^39 - 1.
+template <class Clock = clocks::coarse_clock>
+    requires(std::chrono::is_clock_v<Clock>)
+class throughput_meter {
+public:
+    throughput_meter(time_duration bucketWidth, size_t buckets, size_t shards = std::max(1u, std::thread::hardware_concurrency()))
+        : m_width(std::max(std::chrono::duration_cast<typename Clock::duration>(bucketWidth.chrono()).count(), typename Clock::rep(1))),
+          m_buckets(std::max(buckets, size_t(1))), m_ringSize(m_buckets + 1),
+          m_linesPerShard((m_ringSize + slots_per_line - 1) / slots_per_line), m_shards(std::max(shards, size_t(1))),
+          m_lines(std::make_unique<line[]>(m_shards * m_linesPerShard)) {}
+
+    void record(uint64_t count = 1) noexcept { record(count, time_point<Clock>()); }
+    void record(uint64_t count, const time_point<Clock>& at) noexcept {
+        const int64_t bucket = at.chrono().time_since_epoch().count() / m_width;
+        const uint64_t tag = tag_of(bucket);
+        slot& slot = slot_at(s_thread % m_shards, bucket);
+        while (true) {
+            const int64_t current = slot.bucket.load(std::memory_order_acquire);
+            uint64_t value = slot.value.load(std::memory_order_acquire);
+            if (current > bucket)
+                return; // the slot already moved on to a later bucket, this one is out of the ring
+            if (value & busy) {
+                std::this_thread::yield();
+            } else if (current == bucket) {
+                // the tag catches a restart to a later bucket between the two loads
+                if ((value & tag_mask) == tag && slot.value.compare_exchange_weak(value, add(value, count), std::memory_order_relaxed))
+                    return;
+            } else if (slot.value.compare_exchange_weak(value, busy, std::memory_order_acquire)) {
+                // restart a slot still holding an older bucket, unless someone else got there meanwhile
+                const int64_t latest = slot.bucket.load(std::memory_order_relaxed);
+                if (latest < bucket) {
+                    slot.bucket.store(bucket, std::memory_order_release);
+                    value = tag;
+                }
+                slot.value.store(latest <= bucket ? add(value, count) : value, std::memory_order_release);
+                return;
+            }
+        }
+    }
+
+    // Complete buckets, oldest first. The bucket 'now' falls into is still being written and is not included.
+    std::vector<uint64_t> series(const time_point<Clock>& now = time_point<Clock>()) const {
+        const int64_t current = now.chrono().time_since_epoch().count() / m_width;
+        std::vector<uint64_t> counts(m_buckets);
+        for (size_t i = 0; i < m_buckets; i++)
+            counts[i] = bucket_count(current - int64_t(m_buckets - i));
+        return counts;
+    }
+    // Events per second over the complete buckets covering the last 'window', at least one bucket.
+    double rate(time_duration window, const time_point<Clock>& now = time_point<Clock>()) const {
+        const int64_t current = now.chrono().time_since_epoch().count() / m_width;
+        const int64_t windowBuckets = std::chrono::duration_cast<typename Clock::duration>(window.chrono()).count() / m_width;
+        const int64_t buckets = std::clamp(windowBuckets, int64_t(1), int64_t(m_buckets));
+        uint64_t total = 0;
+        for (int64_t i = 1; i <= buckets; i++)
+            total += bucket_count(current - i);
+        return double(total) / (time_duration(typename Clock::duration(m_width)).fSec() * double(buckets));
+    }
+    // Highest per-bucket rate among the complete buckets, in events per second.
+    double peak_rate(const time_point<Clock>& now = time_point<Clock>()) const {
+        const std::vector<uint64_t> counts = series(now);
+        return double(*std::max_element(counts.begin(), counts.end())) / bucket_width().fSec();
+    }
+
+    time_duration bucket_width() const noexcept { return typename Clock::duration(m_width); }
+    size_t buckets() const noexcept { return m_buckets; }
+    size_t shards() const noexcept { return m_shards; }
+
+private:
+    // 'bucket' is the full bucket number a slot holds. 'value' is 'busy' while the slot is being restarted,
+    // otherwise 'tag | count' with the low bits of that bucket number as tag.
+    static constexpr int count_bits = 39;
+    static constexpr uint64_t count_mask = (uint64_t(1) << count_bits) - 1;
+    static constexpr uint64_t busy = uint64_t(1) << count_bits;
+    static constexpr uint64_t tag_mask = ~(count_mask | busy);
+
+    struct slot {
+        std::atomic<int64_t> bucket{std::numeric_limits<int64_t>::min()};
+        std::atomic<uint64_t> value{0};
+    };
+    static constexpr size_t slots_per_line = 64 / sizeof(slot);
+
+    struct alignas(64) line {
+        slot slots[slots_per_line];
+    };
+
+    static uint64_t tag_of(int64_t bucket) noexcept { return uint64_t(bucket) << (count_bits + 1); }
+    static uint64_t add(uint64_t value, uint64_t count) noexcept {
+        return (value & tag_mask) | ((value & count_mask) + std::min(count, count_mask - (value & count_mask)));
+    }
+
+    slot& slot_at(size_t shard, int64_t bucket) const noexcept {
+        const size_t index = size_t(bucket) % m_ringSize;
+        return m_lines[shard * m_linesPerShard + index / slots_per_line].slots[index % slots_per_line];
+    }
+
+    uint64_t bucket_count(int64_t bucket) const noexcept {
+        const uint64_t tag = tag_of(bucket);
+        uint64_t total = 0;
+        for (size_t shard = 0; shard < m_shards; shard++) {
+            const slot& slot = slot_at(shard, bucket);
+            while (true) {
+                const int64_t before = slot.bucket.load(std::memory_order_acquire);
+                const uint64_t value = slot.value.load(std::memory_order_acquire);
+                if (value & busy) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                if (before == bucket && (value & tag_mask) == tag)
+                    total += value & count_mask;
+                break;
+            }
+        }
+        return total;
+    }
+
+    static inline std::atomic<size_t> s_nextThread{0};
+    static inline thread_local size_t s_thread = s_nextThread.fetch_add(1, std::memory_order_relaxed);
+
+    const typename Clock::rep m_width;
+    const size_t m_buckets;
+    const size_t m_ringSize;
+    const size_t m_linesPerShard;
+    const size_t m_shards;
+    std::unique_ptr<line[]> m_lines;
+};
+} // namespace cpt
+
+namespace cpt {
+// Index of recorded [begin, end) spans for overlap queries. Spans are kept sorted by begin in flat arrays,
+// split into blocks of 'block_size' with a max-end tree over the blocks, so a query only visits blocks
+// that can contain a hit. Ids are positions in the bulk-built input, continued by 'append()'.
+template <class Clock = std::chrono::steady_clock>
+    requires(std::chrono::is_clock_v<Clock>)
+class interval_index {
+public:
+    struct interval {
+        time_point<Clock> begin;
+        time_point<Clock> end;
+    };
+    static constexpr size_t block_size = 64;
+
+    interval_index() = default;
+    explicit interval_index(const std::vector<interval>& intervals) { build(intervals); }
+
+    // Replaces the contents. Throws std::invalid_argument, leaving the contents as they were, if a span ends before it begins.
+    void build(const std::vector<interval>& intervals) {
+        for (const interval& each : intervals) {
+            if (raw(each.end) < raw(each.begin))
+                throw std::invalid_argument("interval_index::build: end is earlier than begin");
+        }
+        std::vector<std::pair<rep, size_t>> order(intervals.size());
+        for (size_t i = 0; i < intervals.size(); i++)
+            order[i] = {raw(intervals[i].begin), i};
+        std::sort(order.begin(), order.end());
+        m_begin.resize(intervals.size());
+        m_end.resize(intervals.size());
+        m_ids.resize(intervals.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            m_begin[i] = order[i].first;
+            m_end[i] = raw(intervals[order[i].second].end);
+            m_ids[i] = order[i].second;
+        }
+        m_nextId = intervals.size();
+        m_blockMax.assign((m_begin.size() + block_size - 1) / block_size, no_end);
+        for (size_t i = 0; i < m_end.size(); i++)
+            m_blockMax[i / block_size] = std::max(m_blockMax[i / block_size], m_end[i]);
+        rebuild_tree();
+    }
+
+    // For spans that arrive in begin order. Throws std::invalid_argument if 'begin' is earlier than the previous one,
+    // or if 'end' is earlier than 'begin'.
+    size_t append(const time_point<Clock>& begin, const time_point<Clock>& end) {
+        const rep rawBegin = raw(begin), rawEnd = raw(end);
+        if (rawEnd < rawBegin)
+            throw std::invalid_argument("interval_index::append: end is earlier than begin");
+        if (!m_begin.empty() && rawBegin < m_begin.back())
+            throw std::invalid_argument("interval_index::append: begin is earlier than the previous one");
+        const size_t id = m_nextId++;
+        m_begin.push_back(rawBegin);
+        m_end.push_back(rawEnd);
+        m_ids.push_back(id);
+        const size_t block = (m_begin.size() - 1) / block_size;
+        if (block == m_blockMax.size()) {
+            m_blockMax.push_back(no_end);
+            if (m_blockMax.size() > m_leaves)
+                rebuild_tree();
+        }
+        if (rawEnd > m_blockMax[block]) {
+            m_blockMax[block] = rawEnd;
+            // stop as soon as an ancestor already covers the new end
+            for (size_t node = m_leaves + block; node != 0 && m_tree[node] < rawEnd; node /= 2)
+                m_tree[node] = rawEnd;
+        }
+        return id;
+    }
+
+    size_t size() const noexcept { return m_begin.size(); }
+    bool empty() const noexcept { return m_begin.empty(); }
+
+    // Calls 'visitor(id, interval)' for every span containing 'at', in begin order.
+    template <class Visitor>
+    void for_each_overlap(const time_point<Clock>& at, Visitor&& visitor) const {
+        visit(raw(at), raw(at) + 1, visitor);
+    }
+    // Calls 'visitor(id, interval)' for every span overlapping [from, to), in begin order.
+    template <class Visitor>
+    void for_each_overlap(const time_point<Clock>& from, const time_point<Clock>& to, Visitor&& visitor) const {
+        visit(raw(from), raw(to), visitor);
+    }
+
+    std::vector<size_t> overlapping(const time_point<Clock>& at) const { return overlapping(at, at + typename Clock::duration(1)); }
+    std::vector<size_t> overlapping(const time_point<Clock>& from, const time_point<Clock>& to) const {
+        std::vector<size_t> ids;
+        visit(raw(from), raw(to), [&ids](size_t id, const interval&) { ids.push_back(id); });
+        return ids;
+    }
+
+    // Part of [from, to) covered by at least one span
+    time_duration covered(const time_point<Clock>& from, const time_point<Clock>& to) const {
+        const rep rawFrom = raw(from), rawTo = raw(to);
+        rep total = 0, runBegin = 0, runEnd = 0;
+        bool inRun = false;
+        visit_raw(rawFrom, rawTo, [&](rep begin, rep end, size_t) {
+            begin = std::max(begin, rawFrom);
+            end = std::min(end, rawTo);
+            if (inRun && begin <= runEnd) {
+                runEnd = std::max(runEnd, end);
+                return;
+            }
+            if (inRun)
+                total += runEnd - runBegin;
+            runBegin = begin;
+            runEnd = end;
+            inRun = true;
+        });
+        if (inRun)
+            total += runEnd - runBegin;
+        return typename Clock::duration(total);
+    }
+
+    // Highest number of spans open at the same time within [from, to)
+    size_t max_concurrency(const time_point<Clock>& from, const time_point<Clock>& to) const {
+        const rep rawFrom = raw(from);
+        std::vector<rep> begins, ends;
+        visit_raw(rawFrom, raw(to), [&](rep begin, rep end, size_t) {
+            if (end <= begin)
+                return;
+            begins.push_back(std::max(begin, rawFrom));
+            ends.push_back(end);
+        });
+        std::sort(begins.begin(), begins.end());
+        std::sort(ends.begin(), ends.end());
+        size_t open = 0, most = 0;
+        // spans are half-open, one ending where another begins does not overlap it
+        for (size_t b = 0, e = 0; b < begins.size(); b++) {
+            while (ends[e] <= begins[b]) {
+                e++;
+                open--;
+            }
+            most = std::max(most, ++open);
+        }
+        return most;
+    }
+
+private:
+    using rep = typename Clock::rep;
+    static constexpr rep no_end = std::numeric_limits<rep>::min();
+
+    static rep raw(const time_point<Clock>& point) noexcept { return point.chrono().time_since_epoch().count(); }
+
+    void rebuild_tree() {
+        m_leaves = 1;
+        while (m_leaves < m_blockMax.size())
+            m_leaves *= 2;
+        m_tree.assign(2 * m_leaves, no_end);
+        std::copy(m_blockMax.begin(), m_blockMax.end(), m_tree.begin() + m_leaves);
+        for (size_t node = m_leaves - 1; node != 0; node--)
+            m_tree[node] = std::max(m_tree[2 * node], m_tree[2 * node + 1]);
     }
-    static constexpr void resume() noexcept {
-        if (!m_paused)
+
+    // Calls 'visitor(begin, end, position)' for spans with begin < to and end > from
+    template <class Visitor>
+    void visit_raw(rep from, rep to, Visitor&& visitor) const {
+        const size_t candidates = std::lower_bound(m_begin.begin(), m_begin.end(), to) - m_begin.begin();
+        if (candidates == 0)
             return;
-        m_totalPauseDuration += BaseClock::now().time_since_epoch() - m_pauseStartPoint;
-        m_paused = false;
+        const size_t lastBlock = (candidates - 1) / block_size;
+        // depth-first over the max-end tree, left to right keeps the begin order
+        size_t stack[64];
+        size_t depth = 0;
+        stack[depth++] = 1;
+        while (depth != 0) {
+            const size_t node = stack[--depth];
+            if (m_tree[node] <= from)
+                continue;
+            // first leaf under 'node'
+            size_t first = node;
+            while (first < m_leaves)
+                first *= 2;
+            if (first - m_leaves > lastBlock)
+                continue;
+            if (node < m_leaves) {
+                stack[depth++] = 2 * node + 1;
+                stack[depth++] = 2 * node;
+                continue;
+            }
+            const size_t block = node - m_leaves;
+            const size_t end = std::min(candidates, (block + 1) * block_size);
+            for (size_t i = block * block_size; i < end; i++) {
+                if (m_end[i] > from)
+                    visitor(m_begin[i], m_end[i], i);
+            }
+        }
+    }
+    template <class Visitor>
+    void visit(rep from, rep to, Visitor&& visitor) const {
+        visit_raw(from, to, [this, &visitor](rep begin, rep end, size_t position) {
+            visitor(m_ids[position], interval{typename Clock::duration(begin), typename Clock::duration(end)});
+        });
+    }
+
+    std::vector<rep> m_begin;
+    std::vector<rep> m_end;
+    std::vector<size_t> m_ids;
+    std::vector<rep> m_blockMax;
+    std::vector<rep> m_tree; // m_tree[m_leaves + block] = m_blockMax[block], parents hold the max of their children
+    size_t m_leaves = 0;
+    size_t m_nextId = 0;
+};
+} // namespace cpt
+
+#if defined(__linux__)
+namespace cpt {
+namespace detail {
+// Clocks that read CLOCK_MONOTONIC itself, their deadlines can be handed to the kernel as is.
+// coarse_clock shares the epoch but lags behind, its deadline would pass in the kernel before it passes in the clock.
+template <class Clock>
+inline constexpr bool monotonic_epoch = std::is_same_v<Clock, std::chrono::steady_clock>;
+
+// Step a clock advances by, zero if it is read from the hardware.
+// Waits are padded by it, so a clock that only advances at ticks is not polled until it catches up.
+template <class Clock>
+std::chrono::nanoseconds clock_step() noexcept {
+    if constexpr (std::is_same_v<Clock, clocks::coarse_clock>) {
+        static const std::chrono::nanoseconds step = [] {
+            timespec resolution{};
+            clock_getres(CLOCK_MONOTONIC_COARSE, &resolution);
+            return std::chrono::seconds(resolution.tv_sec) + std::chrono::nanoseconds(resolution.tv_nsec);
+        }();
+        return step;
+    } else {
+        return std::chrono::nanoseconds(0);
+    }
+}
+
+// A wait on a paused clock has no timeout of its own. It still wakes up this often, because a resume
+// can slip in between checking the clock and going to sleep, or come from another process.
+inline constexpr std::chrono::milliseconds paused_recheck_interval{10};
+
+inline timespec to_timespec(std::chrono::steady_clock::time_point point) noexcept {
+    const std::chrono::nanoseconds sinceEpoch = point.time_since_epoch();
+    timespec result;
+    result.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch).count();
+    result.tv_nsec = (sinceEpoch % std::chrono::seconds(1)).count();
+    return result;
+}
+
+template <class Clock>
+class change_subscription {
+public:
+    explicit change_subscription(const std::atomic<uint32_t>& word) : m_word(word) {
+        if constexpr (clocks::notifies_changes<Clock>)
+            Clock::waiters().add(m_word);
+    }
+    change_subscription(const change_subscription&) = delete;
+    change_subscription& operator=(const change_subscription&) = delete;
+    ~change_subscription() {
+        if constexpr (clocks::notifies_changes<Clock>)
+            Clock::waiters().remove(m_word);
     }
-    static constexpr bool is_paused() noexcept { return m_paused; }
 
 private:
-    static inline bool m_paused{false};
-    static inline duration m_pauseStartPoint{0};
-    static inline duration m_totalPauseDuration{0};
+    const std::atomic<uint32_t>& m_word;
 };
-} // namespace cpt::clocks
\ No newline at end of file
+} // namespace detail
+
+// Blocks while 'word == expected'. Wakes up on 'atomic_notify_*', returns false once 'deadline' has passed in 'Clock'.
+// The deadline is converted to CLOCK_MONOTONIC for the kernel and re-converted after every wake up,
+// so pausing, resuming or adjusting the clock is honored.
+template <class Clock>
+bool atomic_wait_until(const std::atomic<uint32_t>& word, uint32_t expected, const time_point<Clock>& deadline) {
+    detail::change_subscription<Clock> subscription(word);
+    while (word.load(std::memory_order_acquire) == expected) {
+        const typename Clock::time_point now = Clock::now();
+        if (now >= deadline.chrono())
+            return false;
+        std::chrono::steady_clock::time_point wakeAt;
+        if constexpr (detail::monotonic_epoch<Clock>) {
+            wakeAt = std::chrono::steady_clock::time_point(
+                std::chrono::ceil<std::chrono::steady_clock::duration>(deadline.chrono().time_since_epoch()));
+        } else {
+            wakeAt = std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(deadline.chrono() - now) +
+                     detail::clock_step<Clock>();
+        }
+        if constexpr (clocks::pauseable<Clock>) {
+            if (Clock::is_paused())
+                wakeAt = std::chrono::steady_clock::now() + detail::paused_recheck_interval;
+        }
+        const timespec at = detail::to_timespec(wakeAt);
+        detail::futex_wait(word, expected, &at);
+    }
+    return true;
+}
+inline void atomic_wait(const std::atomic<uint32_t>& word, uint32_t expected) noexcept {
+    while (word.load(std::memory_order_acquire) == expected)
+        detail::futex_wait(word, expected, nullptr);
+}
+// Always a system call, the primitives below only notify when someone is waiting.
+inline void atomic_notify_one(std::atomic<uint32_t>& word) noexcept { detail::futex_wake(word, 1); }
+inline void atomic_notify_all(std::atomic<uint32_t>& word) noexcept { detail::futex_wake(word, INT_MAX); }
+
+// Manual-reset event. Once set, releases every waiter until it is reset.
+class event {
+public:
+    explicit event(bool set = false) noexcept : m_state(set ? is_set_state : unset_state) {}
+    event(const event&) = delete;
+    event& operator=(const event&) = delete;
+
+    void set() noexcept {
+        if (m_state.exchange(is_set_state, std::memory_order_release) == waiting_state)
+            detail::futex_wake(m_state, INT_MAX);
+    }
+    void reset() noexcept {
+        uint32_t expected = is_set_state;
+        m_state.compare_exchange_strong(expected, unset_state, std::memory_order_relaxed);
+    }
+    bool is_set() const noexcept { return m_state.load(std::memory_order_acquire) == is_set_state; }
+
+    void wait() noexcept {
+        while (!mark_waiting())
+            atomic_wait(m_state, waiting_state);
+    }
+    template <class Clock>
+    bool wait_until(const time_point<Clock>& deadline) {
+        while (!mark_waiting()) {
+            if (!atomic_wait_until(m_state, waiting_state, deadline))
+                return is_set();
+        }
+        return true;
+    }
+    bool wait_for(const time_duration& timeout) { return wait_until(time_point<>() + timeout); }
+
+private:
+    static constexpr uint32_t unset_state = 0;
+    static constexpr uint32_t is_set_state = 1;
+    static constexpr uint32_t waiting_state = 2; // unset, and someone needs a wake up
+
+    // Returns true if already set
+    bool mark_waiting() noexcept {
+        uint32_t state = m_state.load(std::memory_order_acquire);
+        while (state == unset_state && !m_state.compare_exchange_weak(state, waiting_state, std::memory_order_acquire)) {
+        }
+        return state == is_set_state;
+    }
+
+    std::atomic<uint32_t> m_state;
+};
+
+// Counting semaphore
+class semaphore {
+public:
+    explicit semaphore(uint32_t initial = 0) noexcept : m_count(initial) {}
+    semaphore(const semaphore&) = delete;
+    semaphore& operator=(const semaphore&) = delete;
+
+    void release(uint32_t count = 1) noexcept {
+        m_count.fetch_add(count);
+        if (m_waiters.load() != 0)
+            detail::futex_wake(m_count, int(std::min<uint32_t>(count, INT_MAX)));
+    }
+
+    bool try_acquire() noexcept {
+        uint32_t count = m_count.load(std::memory_order_relaxed);
+        while (count != 0) {
+            if (m_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire))
+                return true;
+        }
+        return false;
+    }
+    void acquire() noexcept {
+        while (!try_acquire()) {
+            m_waiters.fetch_add(1);
+            atomic_wait(m_count, 0);
+            m_waiters.fetch_sub(1);
+        }
+    }
+    template <class Clock>
+    bool try_acquire_until(const time_point<Clock>& deadline) {
+        while (!try_acquire()) {
+            m_waiters.fetch_add(1);
+            const bool woken = atomic_wait_until(m_count, 0, deadline);
+            m_waiters.fetch_sub(1);
+            if (!woken)
+                return try_acquire();
+        }
+        return true;
+    }
+    bool try_acquire_for(const time_duration& timeout) { return try_acquire_until(time_point<>() + timeout); }
+
+    uint32_t available() const noexcept { return m_count.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> m_count;
+    std::atomic<uint32_t> m_waiters{0};
+};
+} // namespace cpt
+#endif
@@ -1,7 +1,14 @@
 #include <iostream>
+#include <random>
 #include <source_location>
 #include <thread>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include "cptlib.h"
 using namespace std::chrono_literals;
 
@@ -88,6 +95,97 @@ void TimeDurationTest_Methods() {
         assert_equal(chronoDuration, 5s);
     }
 }
+// Against std::chrono rounding, only for values where std::chrono itself does not overflow
+template <class Unit>
+void TimeDurationTest_AsUnit(const std::vector<int64_t>& values) {
+    using target = std::chrono::duration<int64_t, Unit>;
+    for (int64_t value : values) {
+        cpt::time_duration duration = std::chrono::nanoseconds(value);
+        std::chrono::nanoseconds chrono(value);
+        assert_equal(duration.as<Unit>(), std::chrono::duration_cast<target>(chrono).count());
+        assert_equal((duration.as<Unit, int64_t, cpt::rounding::floor>()), std::chrono::floor<target>(chrono).count());
+        assert_equal((duration.as<Unit, int64_t, cpt::rounding::ceil>()), std::chrono::ceil<target>(chrono).count());
+        assert_equal((duration.as<Unit, int64_t, cpt::rounding::round>()), std::chrono::round<target>(chrono).count());
+    }
+}
+// Whole int64 range for units that are a whole number of nanoseconds. std::chrono::floor/ceil/round overflow
+// near the ends, so those are derived from duration_cast and the exact remainder.
+template <class Unit>
+void TimeDurationTest_AsBoundaries() {
+    using target = std::chrono::duration<int64_t, Unit>;
+    constexpr int64_t min = std::numeric_limits<int64_t>::min();
+    constexpr int64_t max = std::numeric_limits<int64_t>::max();
+    const int64_t unit = std::chrono::duration_cast<std::chrono::nanoseconds>(target(1)).count();
+    std::vector<int64_t> values = {min, min + 1, max, max - 1, 0, 1, -1};
+    // around multiples and halfway points of the unit, near zero and near both ends of the range
+    const int64_t quarter = (int64_t(1) << 62) / unit * unit;
+    for (int64_t base : {int64_t(0), max / unit * unit, min / unit * unit, quarter, -quarter}) {
+        for (int64_t k = -3; k <= 3; k++) {
+            for (int64_t offset : {int64_t(0), int64_t(1), int64_t(-1), unit / 2, unit / 2 + 1, unit / 2 - 1, -unit / 2, -unit / 2 - 1}) {
+                int64_t value;
+                if (!__builtin_add_overflow(base, k * unit + offset, &value))
+                    values.push_back(value);
+            }
+        }
+    }
+    for (int bit = 0; bit < 63; bit++) {
+        for (int64_t value : {int64_t(1) << bit, (int64_t(1) << bit) - 1, (int64_t(1) << bit) + 1})
+            values.insert(values.end(), {value, -value});
+    }
+    std::mt19937_64 random(unit);
+    std::uniform_int_distribution<int64_t> anything(min, max), near(-10 * unit, 10 * unit);
+    for (int i = 0; i < 100'000; i++)
+        values.insert(values.end(), {anything(random), near(random)});
+
+    for (int64_t value : values) {
+        cpt::time_duration duration = std::chrono::nanoseconds(value);
+        const int64_t truncated = std::chrono::duration_cast<target>(std::chrono::nanoseconds(value)).count();
+        const int64_t remainder = value - truncated * unit;
+        const int64_t away = remainder < 0 ? truncated - 1 : truncated + 1;
+        const int64_t magnitude = remainder < 0 ? -remainder : remainder;
+        int64_t rounded = truncated;
+        if (magnitude > unit - magnitude || (magnitude == unit - magnitude && truncated % 2 != 0))
+            rounded = away;
+        assert_equal(duration.as<Unit>(), truncated);
+        assert_equal((duration.as<Unit, int64_t, cpt::rounding::trunc>()), truncated);
+        assert_equal((duration.as<Unit, int64_t, cpt::rounding::floor>()), remainder < 0 ? away : truncated);
+        assert_equal((duration.as<Unit, int64_t, cpt::rounding::ceil>()), remainder > 0 ? away : truncated);
+        assert_equal((duration.as<Unit, int64_t, cpt::rounding::round>()), rounded);
+    }
+    std::erase_if(values, [unit](int64_t value) { return value < min + unit || value > max - unit; });
+    TimeDurationTest_AsUnit<Unit>(values);
+}
+template <class Rep, cpt::rounding Mode>
+concept TimeDurationTest_AsAccepts = requires(cpt::time_duration duration) { duration.as<std::ratio<60>, Rep, Mode>(); };
+void TimeDurationTest_As() {
+    TimeDurationTest_AsBoundaries<std::micro>();
+    TimeDurationTest_AsBoundaries<std::milli>();
+    TimeDurationTest_AsBoundaries<std::ratio<1>>();
+    TimeDurationTest_AsBoundaries<std::ratio<60>>();
+    TimeDurationTest_AsBoundaries<std::ratio<3600>>();
+    TimeDurationTest_AsBoundaries<std::ratio<86400>>();
+    TimeDurationTest_AsBoundaries<std::ratio<1024, 1'000'000'000>>();
+    // neither a multiple nor a fraction of a nanosecond
+    std::vector<int64_t> values;
+    for (int64_t value = -100'000; value <= 100'000; value++)
+        values.push_back(value);
+    TimeDurationTest_AsUnit<std::ratio<1, 3>>(values);
+    TimeDurationTest_AsUnit<std::ratio<7, 3>>(values);
+    TimeDurationTest_AsUnit<std::nano>({0, 1, -1, 1'000'000, -1'000'000});
+    TimeDurationTest_AsUnit<std::pico>({0, 1, -1, 1'000'000, -1'000'000});
+
+    static_assert(cpt::time_duration(1500ms).as<std::ratio<1>>() == 1);
+    static_assert(cpt::time_duration(1500ms).as<std::ratio<1>, int64_t, cpt::rounding::round>() == 2);
+    static_assert(cpt::time_duration(2500ms).as<std::ratio<1>, int64_t, cpt::rounding::round>() == 2);
+    static_assert(cpt::time_duration(-1500ms).as<std::ratio<1>, int64_t, cpt::rounding::floor>() == -2);
+    static_assert(cpt::time_duration(-1500ms).as<std::ratio<1>, int64_t, cpt::rounding::ceil>() == -1);
+    static_assert(cpt::time_duration(std::chrono::nanoseconds(std::numeric_limits<int64_t>::min())).iSec() == -9223372036);
+    static_assert(cpt::time_duration(90s).as<std::ratio<60>, double>() == 1.5);
+    static_assert(TimeDurationTest_AsAccepts<double, cpt::rounding::trunc> && !TimeDurationTest_AsAccepts<double, cpt::rounding::floor>);
+    static_assert(TimeDurationTest_AsAccepts<int64_t, cpt::rounding::floor>);
+    static_assert(cpt::time_duration(2h).iMin() == 120);
+    assert_equal((cpt::time_duration(1500ms).as<std::milli, int>()), 1500);
+}
 void TimeDurationTest_Operators() {
     // chrono cast
     {
@@ -400,6 +498,25 @@ void TimePointTest_Operators() {
         assert_equal(point1 >= point2, true);
     }
 }
+// Base clocks for pauseable_clock_st, far from their epoch and with a floating point rep
+struct LateClock {
+    using rep = int64_t;
+    using period = std::nano;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<LateClock>;
+    static constexpr bool is_steady = true;
+    static time_point now() noexcept {
+        return time_point(std::chrono::steady_clock::now().time_since_epoch() + duration(int64_t(1) << 62));
+    }
+};
+struct FloatingClock {
+    using rep = double;
+    using period = std::ratio<1>;
+    using duration = std::chrono::duration<double>;
+    using time_point = std::chrono::time_point<FloatingClock>;
+    static constexpr bool is_steady = true;
+    static time_point now() noexcept { return time_point(std::chrono::steady_clock::now().time_since_epoch()); }
+};
 void PauseableClockTest() {
     {
         cpt::time_point<cpt::clocks::pauseable_clock_st<>> point;
@@ -432,11 +549,733 @@ void PauseableClockTest() {
         assert_greater_equal(elapsed.iMilli(), 400 - MILLI_BIAS);
         assert_less(elapsed.iMilli(), 600 + MILLI_BIAS);
     }
+    // base clocks far from their epoch, and with a floating point rep, keep their full range
+    {
+        using late = cpt::clocks::pauseable_clock_st<LateClock, LateClock>;
+        using floating = cpt::clocks::pauseable_clock_st<FloatingClock, FloatingClock>;
+        const late::time_point lateStart = late::now();
+        const floating::time_point floatingStart = floating::now();
+        assert_greater_equal(lateStart.time_since_epoch().count(), int64_t(1) << 62);
+        std::this_thread::sleep_for(20ms);
+        late::pause();
+        floating::pause();
+        const late::time_point latePaused = late::now();
+        const floating::time_point floatingPaused = floating::now();
+        assert_equal(late::is_paused() && floating::is_paused(), true);
+        assert_greater_equal((latePaused - lateStart).count(), 0);
+        assert_greater_equal((floatingPaused - floatingStart).count(), 0);
+        std::this_thread::sleep_for(50ms);
+        assert_equal(late::now() == latePaused, true);
+        assert_equal(floating::now() == floatingPaused, true);
+        late::resume();
+        floating::resume();
+        std::this_thread::sleep_for(20ms);
+        const int64_t lateMilli = std::chrono::duration_cast<std::chrono::milliseconds>(late::now() - lateStart).count();
+        const int64_t floatingMilli = std::chrono::duration_cast<std::chrono::milliseconds>(floating::now() - floatingStart).count();
+        assert_greater_equal(lateMilli, 40);
+        assert_less(lateMilli, 40 + MILLI_BIAS);
+        assert_greater_equal(floatingMilli, 40);
+        assert_less(floatingMilli, 40 + MILLI_BIAS);
+    }
+}
+cpt::task<int> EventLoopTest_Value(cpt::time_duration delay, int value) {
+    co_await cpt::sleep_for(delay);
+    co_return value;
+}
+void EventLoopTest() {
+    // sleep ordering
+    {
+        cpt::event_loop loop;
+        std::vector<int> order;
+        auto sleeper = [](std::vector<int>& order, cpt::time_duration delay, int id) -> cpt::task<void> {
+            co_await cpt::sleep_for(delay);
+            order.push_back(id);
+        };
+        loop.spawn(sleeper(order, 150ms, 3));
+        loop.spawn(sleeper(order, 50ms, 1));
+        loop.spawn(sleeper(order, 100ms, 2));
+        cpt::time_point start;
+        loop.run();
+        assert_greater_equal(start.elapsed().iMilli(), 150 - MILLI_BIAS);
+        assert_equal(order.size(), 3);
+        assert_equal(order[0], 1);
+        assert_equal(order[1], 2);
+        assert_equal(order[2], 3);
+    }
+    // sleep_until
+    {
+        cpt::event_loop loop;
+        cpt::time_point<std::chrono::system_clock> deadline = cpt::time_point<std::chrono::system_clock>() + 100ms;
+        bool woke = false;
+        auto sleeper = [](cpt::time_point<std::chrono::system_clock> deadline, bool& woke) -> cpt::task<void> {
+            co_await cpt::sleep_until(deadline);
+            woke = true;
+        };
+        loop.spawn(sleeper(deadline, woke));
+        loop.run();
+        assert_equal(woke, true);
+        assert_greater_equal((cpt::time_point<std::chrono::system_clock>() - deadline).iNano(), 0);
+    }
+    // with_timeout
+    {
+        cpt::event_loop loop;
+        std::optional<int> fast, slow;
+        bool voidResult = true;
+        auto racer = [](std::optional<int>& fast, std::optional<int>& slow, bool& voidResult) -> cpt::task<void> {
+            fast = co_await cpt::with_timeout(EventLoopTest_Value(20ms, 7), 200ms);
+            slow = co_await cpt::with_timeout(EventLoopTest_Value(200ms, 7), 20ms);
+            voidResult = co_await cpt::with_timeout(cpt::sleep_for(200ms), 20ms);
+        };
+        loop.spawn(racer(fast, slow, voidResult));
+        loop.run();
+        assert_equal(fast.has_value(), true);
+        assert_equal(*fast, 7);
+        assert_equal(slow.has_value(), false);
+        assert_equal(voidResult, false);
+        assert_equal(loop.pending_timers(), 0);
+    }
+    // paused clocks do not fire
+    {
+        struct EventLoopClockId {};
+        using clock = cpt::clocks::pauseable_clock_st<EventLoopClockId>;
+        cpt::event_loop loop;
+        cpt::time_duration sleptFor;
+        auto sleeper = [](cpt::time_duration& sleptFor) -> cpt::task<void> {
+            cpt::time_point start;
+            co_await cpt::sleep_for<clock>(100ms);
+            sleptFor = start.elapsed();
+        };
+        auto pauser = []() -> cpt::task<void> {
+            clock::pause();
+            co_await cpt::sleep_for(200ms);
+            clock::resume();
+        };
+        loop.spawn(sleeper(sleptFor));
+        loop.spawn(pauser());
+        loop.run();
+        assert_greater_equal(sleptFor.iMilli(), 300 - MILLI_BIAS);
+
+        // resumed from another thread while nothing else is pending, run keeps waiting for it
+        clock::pause();
+        std::thread resumer([] {
+            std::this_thread::sleep_for(100ms);
+            clock::resume();
+        });
+        cpt::time_point start;
+        loop.spawn(sleeper(sleptFor));
+        loop.run();
+        resumer.join();
+        assert_equal(loop.pending_timers(), 0);
+        assert_greater_equal(start.elapsed().iMilli(), 200 - MILLI_BIAS);
+        assert_less(start.elapsed().iMilli(), 200 + MILLI_BIAS);
+
+        // paused from another thread, the loop wakes up on resume instead of at the next unrelated timer
+        bool steadyDone = false;
+        auto steadySleeper = [](bool& done) -> cpt::task<void> {
+            co_await cpt::sleep_for(1s);
+            done = true;
+        };
+        cpt::time_duration firedAfter;
+        auto shortSleeper = [](cpt::time_duration& firedAfter) -> cpt::task<void> {
+            cpt::time_point start;
+            co_await cpt::sleep_for<clock>(50ms);
+            firedAfter = start.elapsed();
+            cpt::event_loop::current()->stop();
+        };
+        std::thread pauseThread([] {
+            std::this_thread::sleep_for(5ms);
+            clock::pause();
+            std::this_thread::sleep_for(100ms);
+            clock::resume();
+        });
+        loop.spawn(steadySleeper(steadyDone));
+        loop.spawn(shortSleeper(firedAfter));
+        loop.run();
+        pauseThread.join();
+        assert_equal(steadyDone, false);
+        assert_greater_equal(firedAfter.iMilli(), 150 - MILLI_BIAS);
+        assert_less(firedAfter.iMilli(), 150 + MILLI_BIAS);
+    }
+    // out of file descriptors
+    {
+        pid_t child = fork();
+        if (child == 0) {
+            rlimit limit{3, 3};
+            bool threw = false;
+            if (setrlimit(RLIMIT_NOFILE, &limit) == 0) {
+                try {
+                    cpt::event_loop loop;
+                } catch (const std::system_error& error) {
+                    threw = error.code() == std::errc::too_many_files_open;
+                }
+            }
+            _exit(threw ? 0 : 1);
+        }
+        int status = -1;
+        waitpid(child, &status, 0);
+        assert_equal(WIFEXITED(status) && WEXITSTATUS(status) == 0, true);
+    }
+}
+void PeriodicExecutorTest() {
+    // thread pool
+    {
+        std::atomic<int> sum = 0;
+        {
+            cpt::thread_pool pool(4);
+            for (int i = 1; i <= 1000; i++)
+                pool.submit([&sum, &pool, i] { pool.submit([&sum, i] { sum += i; }); });
+        }
+        assert_equal(sum.load(), 500500);
+    }
+    // ticks do not drift
+    {
+        std::atomic<int> runs = 0;
+        cpt::thread_pool pool(2);
+        cpt::periodic_executor executor(pool);
+        cpt::time_point start;
+        auto id = executor.schedule(10ms, [&runs] {
+            runs++;
+            std::this_thread::sleep_for(3ms);
+        });
+        std::this_thread::sleep_for(505ms);
+        auto stats = executor.stats(id);
+        assert_equal(executor.cancel(id), true);
+        assert_equal(executor.cancel(id), false);
+        assert_greater_equal(runs.load(), 50 - 3);
+        assert_less(runs.load(), 51);
+        assert_equal(stats.has_value(), true);
+        assert_greater_equal(stats->max.iNano(), stats->mean.iNano());
+        assert_greater_equal(stats->mean.iNano(), stats->min.iNano());
+        assert_greater_equal(stats->min.iNano(), 0);
+    }
+    // missed ticks
+    {
+        std::atomic<int> skipRuns = 0, catchUpRuns = 0, coalesceRuns = 0;
+        auto body = [](std::atomic<int>& runs) {
+            return [&runs] {
+                if (runs++ == 0)
+                    std::this_thread::sleep_for(105ms);
+            };
+        };
+        cpt::thread_pool pool(4);
+        cpt::periodic_executor executor(pool);
+        cpt::time_point first = cpt::time_point() + 20ms;
+        auto skip = executor.schedule(20ms, body(skipRuns), cpt::missed_tick_policy::skip, first);
+        auto catchUp = executor.schedule(20ms, body(catchUpRuns), cpt::missed_tick_policy::catch_up, first);
+        auto coalesce = executor.schedule(20ms, body(coalesceRuns), cpt::missed_tick_policy::coalesce, first);
+        std::this_thread::sleep_until((first + 200ms).chrono());
+        assert_greater_equal(catchUpRuns.load(), coalesceRuns.load() + 3);
+        assert_greater(coalesceRuns.load(), skipRuns.load());
+        assert_greater_equal(executor.stats(catchUp)->max.iMilli(), 60);
+        assert_less(executor.stats(coalesce)->max.iMilli(), 20 + MILLI_BIAS);
+        assert_less(executor.stats(skip)->max.iMilli(), MILLI_BIAS);
+    }
+    // periods that would never advance
+    {
+        cpt::thread_pool pool(1);
+        cpt::periodic_executor executor(pool);
+        for (cpt::time_duration period : {cpt::time_duration(0ms), cpt::time_duration(-5ms)}) {
+            bool threw = false;
+            try {
+                executor.schedule(period, [] {});
+            } catch (const std::invalid_argument&) {
+                threw = true;
+            }
+            assert_equal(threw, true);
+        }
+        assert_equal(executor.size(), 0);
+    }
+    // throwing bodies stay scheduled
+    {
+        std::atomic<int> runs = 0;
+        cpt::thread_pool pool(2);
+        cpt::periodic_executor executor(pool);
+        auto id = executor.schedule(10ms, [&runs] {
+            if (runs++ % 2 == 0)
+                throw std::runtime_error("tick");
+        });
+        assert_equal(executor.last_error(id) == nullptr, true);
+        std::this_thread::sleep_for(105ms);
+        executor.cancel(id);
+        assert_greater_equal(runs.load(), 5);
+        // cancelled tasks have no stats
+        assert_equal(executor.last_error(id) == nullptr, true);
+        id = executor.schedule(10ms, [] { throw std::runtime_error("always"); });
+        std::this_thread::sleep_for(35ms);
+        std::optional<cpt::lateness_stats> stats = executor.stats(id);
+        assert_greater_equal(stats->failures, 2);
+        // a run may be in progress
+        assert_greater_equal(stats->count, stats->failures);
+        assert_less(stats->count - stats->failures, 2);
+        assert_equal(executor.last_error(id) != nullptr, true);
+    }
+}
+void WatchdogTest() {
+    struct stall {
+        uint64_t id;
+        std::thread::id thread;
+        cpt::time_duration duration;
+    };
+    // stalls are reported once
+    {
+        std::mutex mutex;
+        std::vector<stall> stalls;
+        cpt::watchdog<std::chrono::steady_clock> watchdog(50ms, 5ms, [&](const auto& heartbeat, cpt::time_duration duration) {
+            std::lock_guard lock(mutex);
+            stalls.push_back({heartbeat.id(), heartbeat.thread(), duration});
+        });
+        std::thread::id workerId;
+        std::thread worker([&] {
+            auto& heartbeat = watchdog.add();
+            workerId = std::this_thread::get_id();
+            for (cpt::time_point start; start.elapsed() < 100ms;) {
+                heartbeat.beat();
+                std::this_thread::sleep_for(2ms);
+            }
+            std::this_thread::sleep_for(150ms);
+            heartbeat.beat();
+            std::this_thread::sleep_for(20ms);
+            watchdog.remove(heartbeat);
+        });
+        worker.join();
+        std::lock_guard lock(mutex);
+        assert_equal(stalls.size(), 1);
+        assert_equal(stalls[0].id, 0);
+        assert_equal(stalls[0].thread == workerId, true);
+        assert_greater(stalls[0].duration.iMilli(), 50 - 1);
+        assert_less(stalls[0].duration.iMilli(), 50 + MILLI_BIAS);
+    }
+    // nothing is reported while the clock is paused
+    {
+        struct WatchdogClockId {};
+        using clock = cpt::clocks::pauseable_clock_st<WatchdogClockId>;
+        std::atomic<int> stalls = 0;
+        cpt::watchdog<clock> watchdog(50ms, 5ms, [&](const auto&, cpt::time_duration) { stalls++; });
+        auto& heartbeat = watchdog.add();
+        heartbeat.beat();
+        clock::pause();
+        std::this_thread::sleep_for(150ms);
+        clock::resume();
+        heartbeat.beat();
+        std::this_thread::sleep_for(20ms);
+        assert_equal(stalls.load(), 0);
+        std::this_thread::sleep_for(100ms);
+        assert_equal(stalls.load(), 1);
+    }
+}
+void SharedPauseableClockTest() {
+    // shared between processes
+    {
+        using clock = cpt::clocks::shared_pauseable_clock<"/cptlib_test_clock">;
+        clock::unlink();
+        int toChild[2], toParent[2];
+        assert_equal(pipe(toChild), 0);
+        assert_equal(pipe(toParent), 0);
+        char message = 0;
+        pid_t child = fork();
+        if (child == 0) {
+            // both processes race to create the segment
+            clock::attach();
+            bool ok = read(toChild[0], &message, 1) == 1 && clock::is_paused();
+            cpt::time_point<clock> point;
+            std::this_thread::sleep_for(50ms);
+            ok = ok && point.elapsed().iNano() == 0;
+            ok = ok && write(toParent[1], &message, 1) == 1;
+            ok = ok && read(toChild[0], &message, 1) == 1 && !clock::is_paused();
+            std::this_thread::sleep_for(50ms);
+            ok = ok && point.elapsed().iMilli() >= 50 - MILLI_BIAS;
+            _exit(ok ? 0 : 1);
+        }
+        clock::attach();
+        cpt::time_point<clock> point;
+        clock::pause();
+        assert_equal(write(toChild[1], &message, 1), 1);
+        assert_equal(read(toParent[0], &message, 1), 1);
+        clock::resume();
+        assert_equal(write(toChild[1], &message, 1), 1);
+        int status = -1;
+        waitpid(child, &status, 0);
+        assert_equal(WIFEXITED(status) && WEXITSTATUS(status) == 0, true);
+        assert_greater_equal(point.elapsed().iMilli(), 50 - MILLI_BIAS);
+        assert_less(point.elapsed().iMilli(), 100);
+        clock::unlink();
+        for (int fd : {toChild[0], toChild[1], toParent[0], toParent[1]})
+            close(fd);
+    }
+    // never steps backwards while another thread pauses and resumes it
+    {
+        using clock = cpt::clocks::shared_pauseable_clock<"/cptlib_test_clock_threads">;
+        clock::unlink();
+        std::atomic<bool> done = false;
+        std::thread pauser([&done] {
+            while (!done) {
+                clock::pause();
+                std::this_thread::sleep_for(100us);
+                clock::resume();
+                std::this_thread::sleep_for(100us);
+            }
+        });
+        bool backwards = false;
+        clock::time_point previous = clock::now();
+        for (cpt::time_point start; start.elapsed() < 50ms;) {
+            const clock::time_point now = clock::now();
+            backwards = backwards || now < previous;
+            previous = now;
+        }
+        done = true;
+        pauser.join();
+        assert_equal(backwards, false);
+        clock::unlink();
+    }
+    // a process that crashed while initializing the segment is taken over
+    {
+        using clock = cpt::clocks::shared_pauseable_clock<"/cptlib_test_clock_crashed">;
+        clock::unlink();
+        pid_t dead = fork();
+        if (dead == 0)
+            _exit(0);
+        waitpid(dead, nullptr, 0);
+        int fd = shm_open("/cptlib_test_clock_crashed", O_RDWR | O_CREAT, 0666);
+        assert_equal(ftruncate(fd, 4096), 0);
+        auto* memory = static_cast<uint64_t*>(mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        close(fd);
+        memory[2] = (uint64_t(1) << 32) | uint32_t(dead); // init word, claimed by a dead process
+        clock::attach();
+        assert_equal(memory[2], uint64_t(2) << 32);
+        assert_equal(clock::is_paused(), false);
+
+        // a writer died halfway through resuming: it holds the lock and filled part of the inactive slot
+        clock::pause();
+        const auto pausedAt = clock::now();
+        const uint64_t generation = memory[8] >> 32; // control word, the slots follow it
+        uint64_t* inactive = &memory[9 + 3 * ((generation + 1) & 1)];
+        memory[8] = (generation << 32) | uint32_t(dead);
+        inactive[0] = 0;
+        inactive[2] = uint64_t(1) << 62;
+        std::this_thread::sleep_for(20ms);
+        assert_equal(clock::is_paused(), true);
+        assert_equal(clock::now() == pausedAt, true);
+        // the next writer takes over the lock, the half-written update never becomes visible
+        clock::resume();
+        assert_equal(clock::is_paused(), false);
+        assert_less(cpt::time_point<clock>(pausedAt).elapsed().iMilli(), 5);
+        assert_greater_equal(cpt::time_point<clock>(pausedAt).elapsed().iNano(), 0);
+        // a writer that is alive but stopped holding the lock delays readers only once
+        const uint64_t unlocked = memory[8];
+        memory[8] = unlocked | uint32_t(getppid());
+        cpt::time_point start;
+        for (int i = 0; i < 1000; i++)
+            clock::now();
+        assert_less(start.elapsed().iMilli(), 50);
+        assert_equal(clock::is_paused(), false);
+        memory[8] = unlocked;
+        munmap(memory, 4096);
+        clock::unlink();
+    }
+}
+void ThroughputMeterTest() {
+    using clock = cpt::clocks::coarse_clock;
+    // explicit time points
+    {
+        cpt::throughput_meter meter(100ms, 4, 3);
+        assert_equal(meter.bucket_width() == 100ms, true);
+        const int64_t width = std::chrono::nanoseconds(100ms).count();
+        cpt::time_point<clock> base = clock::duration(clock::now().time_since_epoch().count() / width * width);
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < 4; thread++) {
+            threads.emplace_back([&meter, base] {
+                for (int bucket = 0; bucket < 6; bucket++) {
+                    for (int i = 0; i < 1000 * (bucket + 1); i++)
+                        meter.record(1, base + 100ms * bucket + 10ms);
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+        cpt::time_point<clock> now = base + 650ms;
+        std::vector<uint64_t> series = meter.series(now);
+        assert_equal(series.size(), 4);
+        assert_equal(series[0], 4 * 3000);
+        assert_equal(series[1], 4 * 4000);
+        assert_equal(series[2], 4 * 5000);
+        assert_equal(series[3], 4 * 6000);
+        assert_equal(meter.rate(100ms, now), 4 * 6000 / 0.1);
+        assert_equal(meter.rate(200ms, now), 4 * 11000 / 0.2);
+        assert_equal(meter.rate(10s, now), 4 * 18000 / 0.4);
+        assert_equal(meter.peak_rate(now), 4 * 6000 / 0.1);
+        // buckets that fell out of the ring read as empty when their slots are reused
+        meter.record(5, base + 700ms);
+        series = meter.series(base + 850ms);
+        assert_equal(series[0], 4 * 5000);
+        assert_equal(series[3], 5);
+        series = meter.series(base + 1500ms);
+        assert_equal(series[0] + series[1] + series[2] + series[3], 0);
+    }
+    // slots idle for longer than the tag bits can tell apart
+    {
+        cpt::throughput_meter meter(1ms, 10, 1);
+        cpt::time_point<clock> base = clock::duration(0);
+        for (int bucket = 0; bucket < 11; bucket++)
+            meter.record(1, base + 1ms * bucket);
+        cpt::time_point<clock> later = base + std::chrono::milliseconds((int64_t(1) << 23) + 100);
+        for (int i = 0; i < 1000; i++)
+            meter.record(1, later);
+        assert_equal(meter.series(later + 1ms).back(), 1000);
+        // a slot last written a multiple of both the ring size and the tag range ago
+        cpt::time_point<clock> aliased = base + std::chrono::milliseconds(11 * (int64_t(1) << 24));
+        assert_equal(meter.series(aliased + 1ms).back(), 0);
+        meter.record(1, aliased);
+        assert_equal(meter.series(aliased + 1ms).back(), 1);
+        // counts saturate instead of spilling into the tag
+        meter.record(uint64_t(1) << 45, aliased);
+        meter.record(1, aliased);
+        assert_equal(meter.series(aliased + 1ms).back(), (uint64_t(1) << 39) - 1);
+    }
+    // current time
+    {
+        cpt::throughput_meter meter(20ms, 10);
+        cpt::time_point start;
+        while (start.elapsed() < 150ms) {
+            meter.record(10);
+            std::this_thread::sleep_for(1ms);
+        }
+        assert_greater(meter.rate(100ms), 0);
+        assert_less(meter.rate(100ms), 10 * 1000 * 1.1);
+    }
+}
+void WaitTest() {
+    // event
+    {
+        cpt::event event;
+        assert_equal(event.is_set(), false);
+        cpt::time_point start;
+        assert_equal(event.wait_for(50ms), false);
+        assert_greater_equal(start.elapsed().iMilli(), 50);
+
+        std::thread setter([&event] {
+            std::this_thread::sleep_for(50ms);
+            event.set();
+        });
+        start = cpt::time_point();
+        assert_equal(event.wait_for(1s), true);
+        assert_greater_equal(start.elapsed().iMilli(), 50 - MILLI_BIAS);
+        assert_less(start.elapsed().iMilli(), 50 + MILLI_BIAS);
+        setter.join();
+        event.wait();
+        event.reset();
+        assert_equal(event.wait_for(1ms), false);
+    }
+    // semaphore
+    {
+        cpt::semaphore semaphore(2);
+        assert_equal(semaphore.try_acquire(), true);
+        assert_equal(semaphore.try_acquire_for(10ms), true);
+        assert_equal(semaphore.try_acquire_for(10ms), false);
+
+        std::atomic<int> acquired = 0;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; i++) {
+            threads.emplace_back([&] {
+                if (semaphore.try_acquire_for(1s))
+                    acquired++;
+            });
+        }
+        std::this_thread::sleep_for(20ms);
+        semaphore.release(3);
+        std::this_thread::sleep_for(20ms);
+        assert_equal(acquired.load(), 3);
+        semaphore.release();
+        for (std::thread& thread : threads)
+            thread.join();
+        assert_equal(acquired.load(), 4);
+        assert_equal(semaphore.available(), 0);
+    }
+    // timeouts on the coarse clock sleep instead of spinning until the clock catches up
+    {
+        using clock = cpt::clocks::coarse_clock;
+        std::atomic<uint32_t> word = 0;
+        cpt::event event;
+        timespec cpuBefore;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuBefore);
+        cpt::time_point start;
+        for (int i = 0; i < 50; i++) {
+            cpt::time_point<clock> deadline = cpt::time_point<clock>() + 2ms;
+            assert_equal(cpt::atomic_wait_until(word, 0, deadline), false);
+            assert_greater_equal((cpt::time_point<clock>() - deadline).iNano(), 0);
+            deadline = cpt::time_point<clock>() + 2ms;
+            assert_equal(event.wait_until(deadline), false);
+            assert_greater_equal((cpt::time_point<clock>() - deadline).iNano(), 0);
+        }
+        timespec cpuAfter;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuAfter);
+        const int64_t cpuMicro = (cpuAfter.tv_sec - cpuBefore.tv_sec) * 1'000'000 + (cpuAfter.tv_nsec - cpuBefore.tv_nsec) / 1000;
+        assert_less(cpuMicro, start.elapsed().iMicro() / 4);
+    }
+    // deadlines on a pauseable clock move with pauses
+    {
+        using clock = cpt::clocks::shared_pauseable_clock<"/cptlib_test_wait_clock">;
+        clock::unlink();
+        clock::attach();
+        std::atomic<uint32_t> word = 0;
+        std::thread pauser([] {
+            std::this_thread::sleep_for(20ms);
+            clock::pause();
+            std::this_thread::sleep_for(100ms);
+            clock::resume();
+        });
+        cpt::time_point start;
+        assert_equal(cpt::atomic_wait_until(word, 0, cpt::time_point<clock>() + 50ms), false);
+        assert_greater_equal(start.elapsed().iMilli(), 150 - MILLI_BIAS);
+        assert_less(start.elapsed().iMilli(), 150 + MILLI_BIAS);
+        pauser.join();
+
+        // paused clock, woken by a notify
+        clock::pause();
+        std::thread notifier([&word] {
+            std::this_thread::sleep_for(50ms);
+            word = 1;
+            cpt::atomic_notify_all(word);
+        });
+        assert_equal(cpt::atomic_wait_until(word, 0, cpt::time_point<clock>() + 1ms), true);
+        notifier.join();
+        clock::resume();
+        clock::unlink();
+    }
+    // in-process pauseable clock paused and resumed by another thread while others wait and read it
+    {
+        struct WaitClockId {};
+        using clock = cpt::clocks::pauseable_clock_st<WaitClockId>;
+        std::atomic<uint32_t> word = 0;
+        std::atomic<bool> done = false;
+        std::atomic<bool> backwards = false;
+        std::thread pauser([&done] {
+            while (!done) {
+                clock::pause();
+                std::this_thread::sleep_for(100us);
+                clock::resume();
+                std::this_thread::sleep_for(100us);
+            }
+        });
+        std::thread reader([&done, &backwards] {
+            clock::time_point previous = clock::now();
+            while (!done) {
+                const clock::time_point now = clock::now();
+                backwards = backwards || now < previous;
+                previous = now;
+            }
+        });
+        std::vector<std::thread> waiters;
+        std::atomic<int> timedOut = 0;
+        for (int i = 0; i < 4; i++) {
+            waiters.emplace_back([&word, &timedOut] {
+                if (!cpt::atomic_wait_until(word, 0, cpt::time_point<clock>() + 20ms))
+                    timedOut++;
+            });
+        }
+        for (std::thread& waiter : waiters)
+            waiter.join();
+        assert_equal(timedOut.load(), 4);
+        done = true;
+        pauser.join();
+        reader.join();
+        assert_equal(backwards.load(), false);
+        clock::resume();
+    }
+}
+void IntervalIndexTest() {
+    using index_type = cpt::interval_index<>;
+    using point = cpt::time_point<>;
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> begins(0, 10'000), lengths(0, 300);
+    std::vector<index_type::interval> intervals;
+    for (int i = 0; i < 2000; i++) {
+        int begin = begins(random);
+        intervals.push_back({point(std::chrono::microseconds(begin)), point(std::chrono::microseconds(begin + lengths(random)))});
+    }
+    std::vector<size_t> byBegin(intervals.size());
+    for (size_t i = 0; i < byBegin.size(); i++)
+        byBegin[i] = i;
+    std::stable_sort(byBegin.begin(), byBegin.end(), [&](size_t lhs, size_t rhs) { return intervals[lhs].begin < intervals[rhs].begin; });
+
+    index_type bulk(intervals);
+    index_type streamed;
+    for (size_t i : byBegin)
+        streamed.append(intervals[i].begin, intervals[i].end);
+    assert_equal(bulk.size(), intervals.size());
+    assert_equal(streamed.size(), intervals.size());
+
+    for (int query = 0; query < 300; query++) {
+        point from(std::chrono::microseconds(begins(random)));
+        point to = from + std::chrono::microseconds(lengths(random) + 1);
+        // brute force
+        std::vector<size_t> expected;
+        for (size_t i : byBegin) {
+            if (intervals[i].begin < to && intervals[i].end > from)
+                expected.push_back(i);
+        }
+        std::vector<size_t> stabbed;
+        for (size_t i : byBegin) {
+            if (intervals[i].begin <= from && intervals[i].end > from)
+                stabbed.push_back(i);
+        }
+        cpt::time_duration covered;
+        size_t concurrency = 0;
+        for (point at = from; at < to; at += 1us) {
+            size_t open = 0;
+            for (size_t i : expected)
+                open += intervals[i].begin <= at && intervals[i].end > at;
+            covered += open != 0 ? 1us : 0us;
+            concurrency = std::max(concurrency, open);
+        }
+
+        assert_equal(bulk.overlapping(from, to) == expected, true);
+        assert_equal(bulk.overlapping(from) == stabbed, true);
+        assert_equal(bulk.covered(from, to) == covered, true);
+        assert_equal(bulk.max_concurrency(from, to), concurrency);
+        // ids of the streamed index are positions in begin order
+        std::vector<size_t> streamedIds;
+        streamed.for_each_overlap(from, to, [&](size_t id, const index_type::interval& interval) {
+            assert_equal(interval.begin == intervals[byBegin[id]].begin, true);
+            assert_equal(interval.end == intervals[byBegin[id]].end, true);
+            streamedIds.push_back(byBegin[id]);
+        });
+        assert_equal(streamedIds == expected, true);
+        assert_equal(streamed.covered(from, to) == covered, true);
+        assert_equal(streamed.max_concurrency(from, to), concurrency);
+    }
+
+    bool threw = false;
+    try {
+        streamed.append(point(0us), point(1us));
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert_equal(threw, true);
+    assert_equal(index_type().overlapping(point(0us)).empty(), true);
+
+    // spans that end before they begin are rejected by both ways of filling the index
+    threw = false;
+    try {
+        streamed.append(point(20'000us), point(19'000us));
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert_equal(threw, true);
+    assert_equal(streamed.size(), intervals.size());
+    threw = false;
+    try {
+        bulk.build({{point(2us), point(4us)}, {point(8us), point(3us)}, {point(9us), point(12us)}});
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert_equal(threw, true);
+    assert_equal(bulk.size(), intervals.size());
 }
 
 int main() {
     TimeDurationTest_Constructors();
     TimeDurationTest_Methods();
+    TimeDurationTest_As();
     TimeDurationTest_Operators();
 
     TimePointTest_Methods();
@@ -444,6 +1283,20 @@ int main() {
 
     PauseableClockTest();
 
+    EventLoopTest();
+
+    PeriodicExecutorTest();
+
+    WatchdogTest();
+
+    SharedPauseableClockTest();
+
+    ThroughputMeterTest();
+
+    WaitTest();
+
+    IntervalIndexTest();
+
     std::cout << "All tests passed." << std::endl;
     return 0;
 }